@@ -1,37 +1,111 @@
 #include "sr_pch.h"
 #include "core/sr_application.h"
+#include "core/sr_benchmark.h"
+#include "core/sr_frame_arena.h"
 #include "core/sr_graphic_device.h"
+#include "core/sr_texture_cache.h"
 #include "shaders/sr_flat_shader.h"
+#include "shaders/sr_textured_shader.h"
 
 Application::Application()
-	: next_sample_index_(0)
-	, debug_infos_(2)
+	: vertex_buffer_(nullptr)
+	, num_vertices_(0)
+	, decoded_texture_(nullptr)
+	, next_sample_index_(0)
+	, num_frames_(0)
+	, debug_infos_(4)
 {
 	graphic_device_ = new GraphicDevice();
+	texture_cache_ = new TextureCache();
 
 	std::fill_n(delta_time_samples_, DELTA_TIME_SAMPLE_COUNT, 0.016666f);
 
 	debug_infos_[0].position = Point(10, 10);
 	debug_infos_[1].position = Point(10, 30);
+	debug_infos_[2].position = Point(10, 50);
+	debug_infos_[3].position = Point(10, 70);
 }
 
 Application::~Application()
 {
+	delete texture_cache_;
 	delete graphic_device_;
 }
 
 void Application::Initialize()
 {
 	graphic_device_->Initialize();
+
+	// The window presents 32-bit BGRA bitmaps, rendering in that order leaves nothing to convert
+	graphic_device_->SetColorFormat(COLOR_FORMAT::BGRA8_UNORM);
+
+	// A textured quad showing the rasterizer diagram tilted away from the camera, the colored triangle if the image is missing
+	const Texture2D* texture = LoadTexture();
+	if (texture)
+	{
+		graphic_device_->SelectShader(SHADER_MODE::TEXTURED);
+
+		// Two units high with the aspect of the image
+		const float half_width = static_cast<float>(texture->width) / static_cast<float>(texture->height);
+		const TexturedAttributeData vertices[6]
+		{
+			{ math::Vector3(-half_width, +1.0f, 0.0f), math::Vector2(0.0f, 0.0f) },
+			{ math::Vector3(-half_width, -1.0f, 0.0f), math::Vector2(0.0f, 1.0f) },
+			{ math::Vector3(+half_width, -1.0f, 0.0f), math::Vector2(1.0f, 1.0f) },
+			{ math::Vector3(-half_width, +1.0f, 0.0f), math::Vector2(0.0f, 0.0f) },
+			{ math::Vector3(+half_width, -1.0f, 0.0f), math::Vector2(1.0f, 1.0f) },
+			{ math::Vector3(+half_width, +1.0f, 0.0f), math::Vector2(1.0f, 0.0f) }
+		};
+		vertex_buffer_ = graphic_device_->CreateVertexBuffer(vertices, sizeof(TexturedAttributeData), 6);
+		num_vertices_ = 6;
+
+		// The shaders multiply row vectors, the matrix builders produce column-vector matrices
+		// The far half of the quad shrinks on screen and samples smaller mip levels, filtered trilinearly
+		const float aspect = static_cast<float>(graphic_device_->GetWidth()) / static_cast<float>(graphic_device_->GetHeight());
+		TexturedConstantData constants;
+		constants.world_matrix = math::MatrixTranspose(math::MatrixTranslate(0.0f, 0.0f, -2.0f) * math::MatrixRotateX(-0.8f));
+		constants.view_matrix = math::MATRIX_IDENTITY;
+		constants.projection_matrix = math::MatrixTranspose(math::MatrixPerspective(1.0f, aspect, 0.1f, 100.0f));
+		constants.texture = texture;
+		constants.sampler = { TEXTURE_FILTER::BILINEAR, TEXTURE_MIP_FILTER::LINEAR, TEXTURE_WRAP::CLAMP, TEXTURE_WRAP::CLAMP };
+		graphic_device_->SetShaderConstants(&constants);
+		return;
+	}
+
+	const FlatAttributeData vertices[3]
+	{
+		{ math::Vector3(-0.0f, +0.5f, 1.0f), math::Vector4(1.0f, 0.0f, 0.0f, 1.0f) },
+		{ math::Vector3(-0.5f, -0.5f, 1.0f), math::Vector4(0.0f, 1.0f, 0.0f, 1.0f) },
+		{ math::Vector3(+0.5f, -0.5f, 1.0f), math::Vector4(0.0f, 0.0f, 1.0f, 1.0f) }
+	};
+	vertex_buffer_ = graphic_device_->CreateVertexBuffer(vertices, sizeof(FlatAttributeData), 3);
+	num_vertices_ = 3;
+
+	FlatConstantData constants;
+	constants.world_matrix = math::MATRIX_IDENTITY;
+	constants.view_matrix = math::MATRIX_IDENTITY;
+	constants.projection_matrix = math::MATRIX_IDENTITY;
+	graphic_device_->SetShaderConstants(&constants);
 }
 
 void Application::Finalize()
 {
+	graphic_device_->ReleaseVertexBuffer(vertex_buffer_);
+	vertex_buffer_ = nullptr;
+
+	if (decoded_texture_)
+	{
+		graphic_device_->ReleaseTexture2D(decoded_texture_);
+		decoded_texture_ = nullptr;
+	}
+	texture_cache_->Close();
+
 	graphic_device_->Finalize();
 }
 
 void Application::Tick(float delta_time)
 {
+	graphic_device_->BeginFrame();
 	graphic_device_->ClearPixelBuffer(math::Vector4(0.3f, 0.3f, 0.3f));
 	graphic_device_->ClearDepthBuffer(1.0f);
 
@@ -54,10 +128,64 @@ void Application::Tick(float delta_time)
 	debug_infos_[0].text = std::format(L"{:0.2f} FPS", fps);
 	debug_infos_[1].text = std::format(L"{:0.2f} ms", mspf);
 
+	// Post-transform vertex cache hit rate of the previous frame
+	const RenderStats& stats = graphic_device_->GetStats();
+	const float hit_rate = stats.num_vertex_lookups > 0 ? static_cast<float>(stats.num_vertex_cache_hits) / static_cast<float>(stats.num_vertex_lookups) : 0.0f;
+	debug_infos_[2].text = std::format(L"{:0.1f}% vertex cache hits", hit_rate * 100.0f);
+	graphic_device_->ResetStats();
+
 	IShader* shader = graphic_device_->GetShader();
 	SR_ASSERT(shader);
 
-	graphic_device_->Draw();
+	graphic_device_->DrawArrays(vertex_buffer_, 0, num_vertices_);
+	graphic_device_->EndFrame();
+
+	// The scene is the same every frame, once the arena has grown to it in the first frame no frame touches the heap
+	const FrameArenaStats arena_stats = graphic_device_->GetFrameArenaStats();
+	SR_ASSERT(num_frames_ == 0 || arena_stats.num_heap_allocations == 0);
+	debug_infos_[3].text = std::format(L"{} KB frame arena, {} heap allocations", arena_stats.num_bytes_allocated / 1024, arena_stats.num_heap_allocations);
+	++num_frames_;
+}
+
+void Application::RunRasterizerBenchmark()
+{
+	constexpr int32_t num_iterations = 10;
+	const std::vector<BenchmarkResult> results = benchmark::RunRasterizerBenchmark(graphic_device_->GetWidth(), graphic_device_->GetHeight(), num_iterations);
+
+	// Keep the results on screen below the frame statistics
+	for (const BenchmarkResult& result : results)
+	{
+		DebugInfo info;
+		info.position = Point(10, 30 + static_cast<int32_t>(debug_infos_.size() - 1) * 20);
+		info.text = std::format(L"{}: {:0.2f} ms", result.name, result.milliseconds);
+		debug_infos_.push_back(info);
+	}
+}
+
+const Texture2D* Application::LoadTexture()
+{
+	const Texture2D* texture = texture_cache_->Open(TEXTURE_CACHE_FILENAME) ? texture_cache_->Find(TEXTURE_FILENAME) : nullptr;
+
+	// A missing or stale cache is rebuilt, closed first so the mapping does not hold the file
+	if (!texture)
+	{
+		texture_cache_->Close();
+		const char* const image_filenames[] = { TEXTURE_FILENAME };
+		if (TextureCache::Build(TEXTURE_CACHE_FILENAME, image_filenames, 1) && texture_cache_->Open(TEXTURE_CACHE_FILENAME))
+		{
+			texture = texture_cache_->Find(TEXTURE_FILENAME);
+		}
+	}
+
+	// The cache could not be written, the image is decoded directly, nullptr if it is missing as well
+	if (!texture)
+	{
+		texture_cache_->Close();
+		decoded_texture_ = graphic_device_->CreateTexture2D(TEXTURE_FILENAME);
+		texture = decoded_texture_;
+	}
+
+	return texture;
 }
 
 const GraphicDevice& Application::GetGraphicDevice() const
@@ -3,6 +3,7 @@
 #include "core/sr_core_types.h"
 
 class GraphicDevice;
+class TextureCache;
 
 struct DebugInfo
 {
@@ -19,6 +20,7 @@ public:
 	void Initialize();
 	void Finalize();
 	void Tick(float delta_time);
+	void RunRasterizerBenchmark();
 
 	const GraphicDevice& GetGraphicDevice() const;
 	const std::vector<DebugInfo>& GetDebugInfos() const;
@@ -26,10 +28,24 @@ public:
 private:
 	static constexpr int32_t DELTA_TIME_SAMPLE_COUNT = 60;
 
+	// Images are read from the texture cache, which is built in the working directory on the first run
+	static constexpr const char* TEXTURE_CACHE_FILENAME = "textures.srtc";
+	static constexpr const char* TEXTURE_FILENAME = "../documents/rasterizer.png";
+
+	// Texture of the quad mapped from the cache, nullptr if the image can not be loaded at all
+	const Texture2D* LoadTexture();
+
+private:
 	GraphicDevice* graphic_device_;
+	TextureCache* texture_cache_;
+	VertexBuffer* vertex_buffer_;
+	int32_t num_vertices_;
+	// Decoded by the device when the cache can not be written, released with it
+	Texture2D* decoded_texture_;
 
 	float delta_time_samples_[DELTA_TIME_SAMPLE_COUNT];
 	int32_t next_sample_index_;
+	int64_t num_frames_;
 
 	std::vector<DebugInfo> debug_infos_;
 };
@@ -0,0 +1,125 @@
+#include "sr_pch.h"
+#include "core/sr_benchmark.h"
+#include "core/sr_rasterizer.h"
+#include "shaders/sr_flat_shader.h"
+
+struct RasterizerEntry
+{
+	const wchar_t* name;
+	rasterizer::RasterizeFunction rasterize_function;
+};
+
+static void AppendTriangles(std::vector<FlatVertexData>& vertices, std::mt19937& random, int32_t count, float radius)
+{
+	std::uniform_real_distribution<float> center_distribution(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> offset_distribution(-radius, radius);
+	std::uniform_real_distribution<float> unit_distribution(0.0f, 1.0f);
+
+	for (int32_t i = 0; i < count; ++i)
+	{
+		const float center_x = center_distribution(random);
+		const float center_y = center_distribution(random);
+		const float depth = unit_distribution(random);
+
+		for (int32_t j = 0; j < 3; ++j)
+		{
+			FlatVertexData vertex;
+			vertex.position = math::Vector4(center_x + offset_distribution(random), center_y + offset_distribution(random), depth, 1.0f);
+			vertex.color = math::Vector4(unit_distribution(random), unit_distribution(random), unit_distribution(random), 1.0f);
+			vertices.push_back(vertex);
+		}
+	}
+}
+
+std::vector<BenchmarkResult> benchmark::RunRasterizerBenchmark(int32_t width, int32_t height, int32_t num_iterations)
+{
+	SR_ASSERT(num_iterations > 0);
+
+	// Small, medium and large triangles in a fixed sequence
+	std::vector<FlatVertexData> vertices;
+	std::mt19937 random(0x5eed);
+	AppendTriangles(vertices, random, 4000, 0.02f);
+	AppendTriangles(vertices, random, 400, 0.15f);
+	AppendTriangles(vertices, random, 20, 0.8f);
+	const int32_t num_triangles = static_cast<int32_t>(vertices.size() / 3);
+
+	const int32_t num_hiz_tiles = ((width + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE) * ((height + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE);
+	std::vector<uint8_t> pixel_buffer(width * height * 4);
+	std::vector<float> depth_buffer(width * height);
+	std::vector<float> hiz_buffer(num_hiz_tiles);
+	std::vector<uint8_t> hiz_dirty(num_hiz_tiles);
+
+	FrameBuffer frame_buffer;
+	frame_buffer.width = width;
+	frame_buffer.height = height;
+	frame_buffer.pixel_buffer = pixel_buffer.data();
+	frame_buffer.color_format = COLOR_FORMAT::RGBA8_UNORM;
+	frame_buffer.depth_buffer = depth_buffer.data();
+	frame_buffer.depth_format = DEPTH_FORMAT::D32_FLOAT;
+	frame_buffer.hiz_buffer = hiz_buffer.data();
+	frame_buffer.hiz_dirty = hiz_dirty.data();
+	frame_buffer.tiled = false;
+	frame_buffer.clear_state = nullptr;
+	frame_buffer.normal_buffer = nullptr;
+	frame_buffer.visibility_buffer = nullptr;
+
+	std::vector<uint8_t> shader_varyings(sizeof(FlatVertexData) * PIXEL_BATCH_SIZE);
+	std::vector<uint8_t> shader_derivatives(sizeof(FlatVertexData) * PIXEL_BATCH_SIZE * 2);
+
+	// The triangles carry flat varyings whatever shader the application draws with
+	FlatShader shader;
+	PipelineContext context{};
+	context.shader = &shader;
+	context.depth_test = true;
+	context.depth_write = true;
+	context.depth_func = DEPTH_FUNC::LESS_EQUAL;
+	context.sizeof_varyings = sizeof(FlatVertexData);
+	context.shader_varyings = shader_varyings.data();
+	context.shader_derivatives = shader_derivatives.data();
+
+	// Generic kernels against the ones specialized for this shader and depth state
+	const RasterizerEntry entries[] =
+	{
+		{ L"V1 scanline", rasterizer::RasterizeTriangle_V1 },
+		{ L"V2 barycentric", rasterizer::RasterizeTriangle_V2 },
+		{ L"V3 edge function", rasterizer::RasterizeTriangle_V3 },
+		{ L"V1 scanline specialized", rasterizer::SelectRasterizeFunction(rasterizer::RasterizeTriangle_V1, context) },
+		{ L"V2 barycentric specialized", rasterizer::SelectRasterizeFunction(rasterizer::RasterizeTriangle_V2, context) },
+		{ L"V3 edge function specialized", rasterizer::SelectRasterizeFunction(rasterizer::RasterizeTriangle_V3, context) },
+	};
+
+	std::vector<BenchmarkResult> results;
+	for (const RasterizerEntry& entry : entries)
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		for (int32_t iteration = 0; iteration < num_iterations; ++iteration)
+		{
+			std::fill(pixel_buffer.begin(), pixel_buffer.end(), static_cast<uint8_t>(0));
+			std::fill(depth_buffer.begin(), depth_buffer.end(), 1.0f);
+			std::fill(hiz_buffer.begin(), hiz_buffer.end(), 1.0f);
+			std::fill(hiz_dirty.begin(), hiz_dirty.end(), static_cast<uint8_t>(0));
+
+			for (int32_t i = 0; i < num_triangles; ++i)
+			{
+				const math::Vector4 clip_coords[3] = { vertices[i * 3 + 0].position, vertices[i * 3 + 1].position, vertices[i * 3 + 2].position };
+				void* varyings[3] = { &vertices[i * 3 + 0], &vertices[i * 3 + 1], &vertices[i * 3 + 2] };
+
+				rasterizer::Triangle triangle;
+				if (rasterizer::SetupTriangle(triangle, frame_buffer, context, clip_coords, varyings))
+				{
+					entry.rasterize_function(frame_buffer, context, triangle, triangle.bounding_box);
+				}
+			}
+		}
+
+		const std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+		BenchmarkResult result;
+		result.name = entry.name;
+		result.milliseconds = elapsed.count() / static_cast<float>(num_iterations);
+		results.push_back(result);
+	}
+
+	return results;
+}
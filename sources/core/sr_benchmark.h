@@ -0,0 +1,13 @@
+#pragma once
+
+struct BenchmarkResult
+{
+	std::wstring name;
+	float milliseconds;
+};
+
+namespace benchmark
+{
+	/* Rasterizes the same triangle sets with every rasterizer and the flat shader on the calling thread, returns milliseconds per iteration */
+	std::vector<BenchmarkResult> RunRasterizerBenchmark(int32_t width, int32_t height, int32_t num_iterations);
+}
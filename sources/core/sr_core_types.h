@@ -2,12 +2,104 @@
 
 class IShader;
 
+// Hierarchical depth keeps the farthest depth of every HIZ_TILE_SIZE x HIZ_TILE_SIZE pixels
+constexpr int32_t HIZ_TILE_SIZE = 8;
+
+// Tiled frame buffers store every FRAME_TILE_SIZE x FRAME_TILE_SIZE block of pixels contiguously
+constexpr int32_t FRAME_TILE_SIZE = 8;
+
+// Fast clears only mark the planes of every FRAME_TILE_SIZE tile, the tile is filled when it is first touched
+constexpr uint8_t TILE_CLEAR_COLOR = 1 << 0;
+constexpr uint8_t TILE_CLEAR_DEPTH = 1 << 1;
+// G-buffer normals, only frame buffers of the deferred geometry pass have them and fill this plane
+constexpr uint8_t TILE_CLEAR_NORMAL = 1 << 2;
+
+// Depth is NDC z in [-1, 1], unorm formats store it remapped to [0, 2^n - 1] and D24 keeps 8 unused high bits
+enum class DEPTH_FORMAT : uint8_t
+{
+	D16_UNORM,
+	D24_UNORM,
+	D32_FLOAT,
+};
+
+// Render target formats, unorm formats clamp colors to [0, 1] and float formats keep the full range
+enum class COLOR_FORMAT : uint8_t
+{
+	RGBA8_UNORM,
+	BGRA8_UNORM,
+	RGB10A2_UNORM,
+	RGBA16_FLOAT,
+	R32_FLOAT,
+};
+
 struct FrameBuffer
 {
 	int32_t width;
 	int32_t height;
 	uint8_t* pixel_buffer;
-	float* depth_buffer;
+	COLOR_FORMAT color_format;
+	void* depth_buffer;
+	DEPTH_FORMAT depth_format;
+	float* hiz_buffer;
+	uint8_t* hiz_dirty;
+
+	// Layout shared by every per-pixel buffer, see framebuffer::PixelOffset
+	bool tiled;
+
+	// Pending fast clears per tile and their values, the color packed in the color format,
+	// nullptr if every buffer is always up to date
+	uint8_t* clear_state;
+	uint64_t clear_color;
+	float clear_depth;
+
+	// G-buffer normals written by deferred shaders packed by framebuffer::PackNormal, nullptr outside the geometry pass
+	uint32_t* normal_buffer;
+
+	// Primitive ids written by the visibility pass, nullptr outside of it
+	uint32_t* visibility_buffer;
+};
+
+enum class DEPTH_FUNC : uint8_t
+{
+	NEVER,
+	LESS,
+	EQUAL,
+	LESS_EQUAL,
+	GREATER,
+	NOT_EQUAL,
+	GREATER_EQUAL,
+	ALWAYS,
+};
+
+enum class CULL_MODE : uint8_t
+{
+	NONE,
+	FRONT,
+	BACK,
+};
+
+enum class FRONT_FACE : uint8_t
+{
+	COUNTER_CLOCKWISE,
+	CLOCKWISE,
+};
+
+constexpr int32_t MAX_VARYING_ATTRIBUTES = 8;
+constexpr int32_t MAX_VARYING_COMPONENTS = 32;
+
+// Interpolated part of a varyings struct, offsets and sizes in floats
+// Attributes with derivatives also get their screen-space derivatives per 2x2 pixel quad
+struct VaryingAttribute
+{
+	int32_t offset;
+	int32_t num_components;
+	bool derivatives;
+};
+
+struct VaryingLayout
+{
+	int32_t num_attributes;
+	VaryingAttribute attributes[MAX_VARYING_ATTRIBUTES];
 };
 
 struct PipelineContext
@@ -18,9 +110,88 @@ struct PipelineContext
 	int32_t sizeof_constants;
 	bool two_sided;
 	bool enable_blend;
+	CULL_MODE cull_mode;
+	FRONT_FACE front_face;
+	bool depth_test;
+	bool depth_write;
+	DEPTH_FUNC depth_func;
 	void* shader_attributes[3];
 	void* shader_varyings;
+	void* shader_derivatives;
 	void* shader_constants;
+	void* clip_varyings;
+	// Id of the triangle being set up, stored in the visibility buffer by the visibility pass
+	uint32_t primitive_id;
+};
+
+struct VertexBuffer
+{
+	uint8_t* vertices;
+	int32_t sizeof_vertex;
+	int32_t num_vertices;
+};
+
+struct IndexBuffer
+{
+	uint32_t* indices;
+	int32_t num_indices;
+};
+
+// Texels are stored in TEXTURE_TILE_SIZE x TEXTURE_TILE_SIZE tiles, one 64-byte cache line per tile
+constexpr int32_t TEXTURE_TILE_SIZE = 4;
+constexpr int32_t MAX_TEXTURE_LEVELS = 16;
+// Largest width or height whose full mip chain fits in MAX_TEXTURE_LEVELS
+constexpr int32_t MAX_TEXTURE_SIZE = 1 << (MAX_TEXTURE_LEVELS - 1);
+
+// Texels are read-only once stored, they may live in a read-only file mapping
+struct TextureLevel
+{
+	const uint32_t* texels;
+	int32_t width;
+	int32_t height;
+	int32_t num_tiles_x;
+	int32_t num_tiles_y;
+};
+
+struct Texture2D
+{
+	int32_t width;
+	int32_t height;
+	int32_t num_levels;
+	TextureLevel levels[MAX_TEXTURE_LEVELS];
+};
+
+enum class TEXTURE_FILTER : uint8_t
+{
+	POINT,
+	BILINEAR,
+};
+
+enum class TEXTURE_MIP_FILTER : uint8_t
+{
+	NONE,
+	POINT,
+	LINEAR,
+};
+
+enum class TEXTURE_WRAP : uint8_t
+{
+	REPEAT,
+	CLAMP,
+};
+
+struct SamplerState
+{
+	TEXTURE_FILTER filter;
+	TEXTURE_MIP_FILTER mip_filter;
+	TEXTURE_WRAP wrap_u;
+	TEXTURE_WRAP wrap_v;
+};
+
+struct RenderStats
+{
+	int64_t num_vertex_lookups;
+	int64_t num_vertex_cache_hits;
 };
 
 struct Point
@@ -28,3 +199,11 @@ struct Point
 	int32_t x;
 	int32_t y;
 };
+
+struct BoundingBox
+{
+	int32_t min_x;
+	int32_t min_y;
+	int32_t max_x;
+	int32_t max_y;
+};
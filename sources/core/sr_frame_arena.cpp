@@ -0,0 +1,111 @@
+#include "sr_pch.h"
+#include "core/sr_frame_arena.h"
+
+// Block memory starts after the header, at the alignment every allocation may ask for
+static constexpr size_t BLOCK_HEADER_SIZE = FrameArena::MAX_ALIGNMENT;
+
+FrameArena::FrameArena(int32_t num_threads)
+{
+	SR_ASSERT(num_threads > 0);
+
+	sub_arenas_.resize(num_threads);
+	for (SubArena& arena : sub_arenas_)
+	{
+		arena.first_block = nullptr;
+		arena.current_block = nullptr;
+		arena.offset = 0;
+		arena.stats = FrameArenaStats();
+	}
+}
+
+FrameArena::~FrameArena()
+{
+	for (SubArena& arena : sub_arenas_)
+	{
+		Block* block = arena.first_block;
+		while (block)
+		{
+			Block* next = block->next;
+			_mm_free(block);
+			block = next;
+		}
+	}
+}
+
+void FrameArena::Reset()
+{
+	for (SubArena& arena : sub_arenas_)
+	{
+		arena.current_block = arena.first_block;
+		arena.offset = 0;
+		arena.stats.num_bytes_allocated = 0;
+		arena.stats.num_heap_allocations = 0;
+	}
+}
+
+void* FrameArena::Allocate(int32_t thread_index, size_t size, size_t alignment)
+{
+	SR_ASSERT(thread_index >= 0 && thread_index < static_cast<int32_t>(sub_arenas_.size()));
+	SR_ASSERT(alignment > 0 && alignment <= MAX_ALIGNMENT && (alignment & (alignment - 1)) == 0);
+
+	SubArena& arena = sub_arenas_[thread_index];
+	for (;;)
+	{
+		if (arena.current_block)
+		{
+			const size_t offset = (arena.offset + alignment - 1) & ~(alignment - 1);
+			if (offset + size <= arena.current_block->size)
+			{
+				arena.offset = offset + size;
+				arena.stats.num_bytes_allocated += size;
+				return GetBlockMemory(arena.current_block) + offset;
+			}
+
+			// The rest of the block stays unused this frame, the next block kept from earlier frames is tried first
+			if (arena.current_block->next)
+			{
+				arena.current_block = arena.current_block->next;
+				arena.offset = 0;
+				continue;
+			}
+		}
+
+		// Out of blocks, allocations larger than a block get a block of their own size
+		const size_t block_size = std::max(BLOCK_SIZE, size);
+		Block* block = reinterpret_cast<Block*>(_mm_malloc(BLOCK_HEADER_SIZE + block_size, MAX_ALIGNMENT));
+		SR_ASSERT(block);
+		block->next = nullptr;
+		block->size = block_size;
+
+		if (arena.current_block)
+		{
+			arena.current_block->next = block;
+		}
+		else
+		{
+			arena.first_block = block;
+		}
+
+		arena.current_block = block;
+		arena.offset = 0;
+		arena.stats.num_bytes_reserved += block_size;
+		++arena.stats.num_heap_allocations;
+	}
+}
+
+FrameArenaStats FrameArena::GetStats() const
+{
+	FrameArenaStats stats{};
+	for (const SubArena& arena : sub_arenas_)
+	{
+		stats.num_bytes_allocated += arena.stats.num_bytes_allocated;
+		stats.num_bytes_reserved += arena.stats.num_bytes_reserved;
+		stats.num_heap_allocations += arena.stats.num_heap_allocations;
+	}
+	return stats;
+}
+
+uint8_t* FrameArena::GetBlockMemory(Block* block)
+{
+	return reinterpret_cast<uint8_t*>(block) + BLOCK_HEADER_SIZE;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+// Allocated bytes and heap allocations count since the last Reset, reserved bytes are every block kept by the arena
+// A frame in steady state makes no heap allocations
+struct FrameArenaStats
+{
+	int64_t num_bytes_allocated;
+	int64_t num_bytes_reserved;
+	int64_t num_heap_allocations;
+};
+
+/*
+ * Linear allocator for data that lives until the end of the frame
+ * Allocations bump an offset inside large blocks and Reset releases all of them at once. Blocks are kept
+ * across frames, so once the arena has grown to the peak of a frame it never touches the heap again.
+ * Every job system thread owns a sub-arena, jobs allocate from the one of their thread index without locking,
+ * so allocations from the same sub-arena must never run concurrently.
+ */
+class FrameArena
+{
+public:
+	static constexpr size_t BLOCK_SIZE = 1 << 20;
+	static constexpr size_t DEFAULT_ALIGNMENT = 16;
+	static constexpr size_t MAX_ALIGNMENT = 64;
+
+	explicit FrameArena(int32_t num_threads);
+	~FrameArena();
+
+	// Every allocation of the previous frame becomes invalid
+	void Reset();
+
+	// Alignment is a power of two up to MAX_ALIGNMENT, the memory is uninitialized
+	void* Allocate(int32_t thread_index, size_t size, size_t alignment = DEFAULT_ALIGNMENT);
+
+	template<typename Type>
+	Type* AllocateArray(int32_t thread_index, size_t count);
+
+	// Sum over all sub-arenas, only valid while no thread is allocating
+	FrameArenaStats GetStats() const;
+
+private:
+	// Blocks form a list per sub-arena, the header sits at the start of the block memory
+	struct Block
+	{
+		Block* next;
+		size_t size;
+	};
+
+	struct alignas(64) SubArena
+	{
+		Block* first_block;
+		Block* current_block;
+		size_t offset;
+		FrameArenaStats stats;
+	};
+
+	static uint8_t* GetBlockMemory(Block* block);
+
+private:
+	std::vector<SubArena> sub_arenas_;
+};
+
+template<typename Type>
+inline Type* FrameArena::AllocateArray(int32_t thread_index, size_t count)
+{
+	return reinterpret_cast<Type*>(Allocate(thread_index, sizeof(Type) * count));
+}
+
+/*
+ * Append-only list of trivially copyable values, stored in chunks allocated from a frame arena
+ * Growing links a new chunk instead of reallocating, so lists rebuilt every frame stay off the heap once
+ * the arena has grown to the peak of a frame. One thread at a time pushes, into the sub-arena of its
+ * thread index, and the values are invalid after the arena is reset like every other frame allocation.
+ */
+template<typename Type, int32_t CHUNK_SIZE = 64>
+class FrameList
+{
+public:
+	FrameList();
+
+	// Forgets the values, their chunks stay in the frame arena until it is reset
+	void Clear();
+	void Push(FrameArena& frame_arena, int32_t thread_index, const Type& value);
+
+	int32_t GetSize() const;
+	bool IsEmpty() const;
+
+	// Calls function for every value in push order
+	template<typename Function>
+	void ForEach(Function&& function) const;
+
+	// Copies the values in push order to dst, which holds GetSize() values
+	void CopyTo(Type* dst) const;
+
+private:
+	struct Chunk
+	{
+		Chunk* next;
+		int32_t count;
+		Type values[CHUNK_SIZE];
+	};
+
+	static_assert(std::is_trivially_copyable_v<Type>);
+	static_assert(alignof(Chunk) <= FrameArena::MAX_ALIGNMENT);
+
+	Chunk* first_chunk_;
+	Chunk* last_chunk_;
+	int32_t size_;
+};
+
+template<typename Type, int32_t CHUNK_SIZE>
+inline FrameList<Type, CHUNK_SIZE>::FrameList()
+	: first_chunk_(nullptr)
+	, last_chunk_(nullptr)
+	, size_(0)
+{
+}
+
+template<typename Type, int32_t CHUNK_SIZE>
+inline void FrameList<Type, CHUNK_SIZE>::Clear()
+{
+	first_chunk_ = nullptr;
+	last_chunk_ = nullptr;
+	size_ = 0;
+}
+
+template<typename Type, int32_t CHUNK_SIZE>
+inline void FrameList<Type, CHUNK_SIZE>::Push(FrameArena& frame_arena, int32_t thread_index, const Type& value)
+{
+	if (!last_chunk_ || last_chunk_->count == CHUNK_SIZE)
+	{
+		Chunk* chunk = reinterpret_cast<Chunk*>(frame_arena.Allocate(thread_index, sizeof(Chunk), alignof(Chunk)));
+		chunk->next = nullptr;
+		chunk->count = 0;
+		if (last_chunk_)
+		{
+			last_chunk_->next = chunk;
+		}
+		else
+		{
+			first_chunk_ = chunk;
+		}
+		last_chunk_ = chunk;
+	}
+
+	last_chunk_->values[last_chunk_->count++] = value;
+	++size_;
+}
+
+template<typename Type, int32_t CHUNK_SIZE>
+inline int32_t FrameList<Type, CHUNK_SIZE>::GetSize() const
+{
+	return size_;
+}
+
+template<typename Type, int32_t CHUNK_SIZE>
+inline bool FrameList<Type, CHUNK_SIZE>::IsEmpty() const
+{
+	return size_ == 0;
+}
+
+template<typename Type, int32_t CHUNK_SIZE>
+template<typename Function>
+inline void FrameList<Type, CHUNK_SIZE>::ForEach(Function&& function) const
+{
+	for (const Chunk* chunk = first_chunk_; chunk; chunk = chunk->next)
+	{
+		for (int32_t i = 0; i < chunk->count; ++i)
+		{
+			function(chunk->values[i]);
+		}
+	}
+}
+
+template<typename Type, int32_t CHUNK_SIZE>
+inline void FrameList<Type, CHUNK_SIZE>::CopyTo(Type* dst) const
+{
+	for (const Chunk* chunk = first_chunk_; chunk; chunk = chunk->next)
+	{
+		memcpy(dst, chunk->values, sizeof(Type) * chunk->count);
+		dst += chunk->count;
+	}
+}
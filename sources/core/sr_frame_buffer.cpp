@@ -0,0 +1,265 @@
+#include "sr_pch.h"
+#include "core/sr_frame_buffer.h"
+
+/* packs the colors four per call, the last group is padded with its last color and only the real pixels are written */
+template<typename Pixel, typename PackFunction>
+static void StorePacked(uint8_t* buffer, const int32_t* offsets, int32_t count, const math::Vector4* colors, PackFunction pack)
+{
+	Pixel* dst = reinterpret_cast<Pixel*>(buffer);
+	alignas(16) Pixel pixels[4];
+	for (int32_t i = 0; i < count; i += 4)
+	{
+		const int32_t num_pixels = math::Min(count - i, 4);
+		__m128 values[4];
+		for (int32_t j = 0; j < 4; ++j)
+		{
+			values[j] = _mm_loadu_ps(&colors[i + math::Min(j, num_pixels - 1)].x);
+		}
+		pack(values, pixels);
+		for (int32_t j = 0; j < num_pixels; ++j)
+		{
+			dst[offsets[i + j]] = pixels[j];
+		}
+	}
+}
+
+/* gathers the pixels four per call, lanes past the last pixel unpack stale bits and are not written */
+template<typename Pixel, typename UnpackFunction>
+static void LoadUnpacked(const uint8_t* buffer, const int32_t* offsets, int32_t count, math::Vector4* colors, UnpackFunction unpack)
+{
+	const Pixel* src = reinterpret_cast<const Pixel*>(buffer);
+	alignas(16) Pixel pixels[4] = {};
+	for (int32_t i = 0; i < count; i += 4)
+	{
+		const int32_t num_pixels = math::Min(count - i, 4);
+		for (int32_t j = 0; j < num_pixels; ++j)
+		{
+			pixels[j] = src[offsets[i + j]];
+		}
+		__m128 values[4];
+		unpack(pixels, values);
+		for (int32_t j = 0; j < num_pixels; ++j)
+		{
+			_mm_storeu_ps(&colors[i + j].x, values[j]);
+		}
+	}
+}
+
+int32_t framebuffer::GetBufferSize(int32_t width, int32_t height)
+{
+	const int32_t num_tiles_x = (width + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE;
+	const int32_t num_tiles_y = (height + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE;
+	return num_tiles_x * num_tiles_y * FRAME_TILE_SIZE * FRAME_TILE_SIZE;
+}
+
+int32_t framebuffer::GetColorSize(COLOR_FORMAT format)
+{
+	return format == COLOR_FORMAT::RGBA16_FLOAT ? sizeof(uint64_t) : sizeof(uint32_t);
+}
+
+void framebuffer::FillColor(COLOR_FORMAT format, uint8_t* dst, int32_t count, uint64_t color)
+{
+	if (format == COLOR_FORMAT::RGBA16_FLOAT)
+	{
+		std::fill_n(reinterpret_cast<uint64_t*>(dst), count, color);
+	}
+	else
+	{
+		std::fill_n(reinterpret_cast<uint32_t*>(dst), count, static_cast<uint32_t>(color));
+	}
+}
+
+void framebuffer::LoadColors(const FrameBuffer& frame_buffer, const int32_t* offsets, int32_t count, math::Vector4* colors)
+{
+	switch (frame_buffer.color_format)
+	{
+	case COLOR_FORMAT::RGBA8_UNORM:
+		LoadUnpacked<uint32_t>(frame_buffer.pixel_buffer, offsets, count, colors, [](const uint32_t* pixels, __m128 values[4])
+		{
+			UnpackUnorm8x4(_mm_load_si128(reinterpret_cast<const __m128i*>(pixels)), values);
+		});
+		break;
+	case COLOR_FORMAT::BGRA8_UNORM:
+		LoadUnpacked<uint32_t>(frame_buffer.pixel_buffer, offsets, count, colors, [](const uint32_t* pixels, __m128 values[4])
+		{
+			UnpackUnorm8x4(_mm_load_si128(reinterpret_cast<const __m128i*>(pixels)), values);
+			for (int32_t i = 0; i < 4; ++i)
+			{
+				values[i] = _mm_shuffle_ps(values[i], values[i], _MM_SHUFFLE(3, 0, 1, 2));
+			}
+		});
+		break;
+	case COLOR_FORMAT::RGB10A2_UNORM:
+		LoadUnpacked<uint32_t>(frame_buffer.pixel_buffer, offsets, count, colors, [](const uint32_t* pixels, __m128 values[4])
+		{
+			for (int32_t i = 0; i < 4; ++i)
+			{
+				values[i] = UnpackUnorm10(pixels[i]);
+			}
+		});
+		break;
+	case COLOR_FORMAT::RGBA16_FLOAT:
+		LoadUnpacked<uint64_t>(frame_buffer.pixel_buffer, offsets, count, colors, [](const uint64_t* pixels, __m128 values[4])
+		{
+			for (int32_t i = 0; i < 4; ++i)
+			{
+				values[i] = UnpackHalf(pixels[i]);
+			}
+		});
+		break;
+	default:
+		LoadUnpacked<uint32_t>(frame_buffer.pixel_buffer, offsets, count, colors, [](const uint32_t* pixels, __m128 values[4])
+		{
+			for (int32_t i = 0; i < 4; ++i)
+			{
+				values[i] = _mm_setr_ps(std::bit_cast<float>(pixels[i]), 0.0f, 0.0f, 1.0f);
+			}
+		});
+		break;
+	}
+}
+
+void framebuffer::StoreColors(const FrameBuffer& frame_buffer, const int32_t* offsets, int32_t count, const math::Vector4* colors)
+{
+	switch (frame_buffer.color_format)
+	{
+	case COLOR_FORMAT::RGBA8_UNORM:
+		StorePacked<uint32_t>(frame_buffer.pixel_buffer, offsets, count, colors, [](const __m128 values[4], uint32_t* pixels)
+		{
+			_mm_store_si128(reinterpret_cast<__m128i*>(pixels), PackUnorm8x4(values));
+		});
+		break;
+	case COLOR_FORMAT::BGRA8_UNORM:
+		StorePacked<uint32_t>(frame_buffer.pixel_buffer, offsets, count, colors, [](const __m128 values[4], uint32_t* pixels)
+		{
+			__m128 swizzled[4];
+			for (int32_t i = 0; i < 4; ++i)
+			{
+				swizzled[i] = _mm_shuffle_ps(values[i], values[i], _MM_SHUFFLE(3, 0, 1, 2));
+			}
+			_mm_store_si128(reinterpret_cast<__m128i*>(pixels), PackUnorm8x4(swizzled));
+		});
+		break;
+	case COLOR_FORMAT::RGB10A2_UNORM:
+		StorePacked<uint32_t>(frame_buffer.pixel_buffer, offsets, count, colors, [](const __m128 values[4], uint32_t* pixels)
+		{
+			_mm_store_si128(reinterpret_cast<__m128i*>(pixels), PackUnorm10x4(values));
+		});
+		break;
+	case COLOR_FORMAT::RGBA16_FLOAT:
+		StorePacked<uint64_t>(frame_buffer.pixel_buffer, offsets, count, colors, [](const __m128 values[4], uint64_t* pixels)
+		{
+			PackHalfx4(values, pixels);
+		});
+		break;
+	default:
+		StorePacked<uint32_t>(frame_buffer.pixel_buffer, offsets, count, colors, [](const __m128 values[4], uint32_t* pixels)
+		{
+			for (int32_t i = 0; i < 4; ++i)
+			{
+				pixels[i] = std::bit_cast<uint32_t>(_mm_cvtss_f32(values[i]));
+			}
+		});
+		break;
+	}
+}
+
+int32_t framebuffer::GetDepthSize(DEPTH_FORMAT format)
+{
+	return format == DEPTH_FORMAT::D16_UNORM ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+void framebuffer::FillDepth(const FrameBuffer& frame_buffer, int32_t offset, int32_t count, float depth)
+{
+	switch (frame_buffer.depth_format)
+	{
+	case DEPTH_FORMAT::D16_UNORM:
+		std::fill_n(reinterpret_cast<uint16_t*>(frame_buffer.depth_buffer) + offset, count, static_cast<uint16_t>(EncodeUnorm(depth, D16_MAX)));
+		break;
+	case DEPTH_FORMAT::D24_UNORM:
+		std::fill_n(reinterpret_cast<uint32_t*>(frame_buffer.depth_buffer) + offset, count, EncodeUnorm(depth, D24_MAX));
+		break;
+	default:
+		std::fill_n(reinterpret_cast<float*>(frame_buffer.depth_buffer) + offset, count, depth);
+		break;
+	}
+}
+
+void framebuffer::FillTile(const FrameBuffer& frame_buffer, int32_t tile_x, int32_t tile_y, uint8_t planes)
+{
+	const int32_t min_x = tile_x * FRAME_TILE_SIZE;
+	const int32_t min_y = tile_y * FRAME_TILE_SIZE;
+	const int32_t max_y = math::Min(min_y + FRAME_TILE_SIZE, frame_buffer.height);
+
+	// Rows of a tile stay inside its padding in both layouts, so every row is filled completely
+	const int32_t color_size = GetColorSize(frame_buffer.color_format);
+	for (int32_t y = min_y; y < max_y; ++y)
+	{
+		const int32_t row_offset = PixelOffset(frame_buffer, min_x, y);
+		const int32_t num_pixels = frame_buffer.tiled ? FRAME_TILE_SIZE : math::Min(FRAME_TILE_SIZE, frame_buffer.width - min_x);
+		if (planes & TILE_CLEAR_COLOR)
+		{
+			FillColor(frame_buffer.color_format, frame_buffer.pixel_buffer + row_offset * color_size, num_pixels, frame_buffer.clear_color);
+		}
+
+		if (planes & TILE_CLEAR_DEPTH)
+		{
+			FillDepth(frame_buffer, row_offset, num_pixels, frame_buffer.clear_depth);
+		}
+
+		// No packed normal is 0, so a zero normal marks the pixel as uncovered
+		if (planes & TILE_CLEAR_NORMAL)
+		{
+			SR_ASSERT(frame_buffer.normal_buffer);
+			memset(frame_buffer.normal_buffer + row_offset, 0, num_pixels * sizeof(uint32_t));
+		}
+	}
+}
+
+void framebuffer::FlushClears(const FrameBuffer& frame_buffer, uint8_t planes)
+{
+	if (!frame_buffer.clear_state)
+	{
+		return;
+	}
+
+	const int32_t num_tiles_x = (frame_buffer.width + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE;
+	const int32_t num_tiles_y = (frame_buffer.height + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE;
+	for (int32_t tile_y = 0; tile_y < num_tiles_y; ++tile_y)
+	{
+		for (int32_t tile_x = 0; tile_x < num_tiles_x; ++tile_x)
+		{
+			uint8_t& state = frame_buffer.clear_state[tile_y * num_tiles_x + tile_x];
+			if (state & planes)
+			{
+				FillTile(frame_buffer, tile_x, tile_y, state & planes);
+				state &= ~planes;
+			}
+		}
+	}
+}
+
+void framebuffer::ResolvePixels(const FrameBuffer& frame_buffer, uint8_t* dst)
+{
+	const int32_t color_size = GetColorSize(frame_buffer.color_format);
+	const int32_t num_tiles_x = (frame_buffer.width + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE;
+
+	// Every tile row is one contiguous copy, the padding of the last tiles is skipped
+	for (int32_t y = 0; y < frame_buffer.height; ++y)
+	{
+		uint8_t* dst_row = dst + y * frame_buffer.width * color_size;
+		const uint8_t* clear_state = frame_buffer.clear_state ? frame_buffer.clear_state + (y / FRAME_TILE_SIZE) * num_tiles_x : nullptr;
+		for (int32_t block_x = 0; block_x < frame_buffer.width; block_x += FRAME_TILE_SIZE)
+		{
+			const int32_t num_pixels = math::Min(FRAME_TILE_SIZE, frame_buffer.width - block_x);
+			if (clear_state && (clear_state[block_x / FRAME_TILE_SIZE] & TILE_CLEAR_COLOR))
+			{
+				FillColor(frame_buffer.color_format, dst_row + block_x * color_size, num_pixels, frame_buffer.clear_color);
+			}
+			else
+			{
+				memcpy(dst_row + block_x * color_size, frame_buffer.pixel_buffer + PixelOffset(frame_buffer, block_x, y) * color_size, num_pixels * color_size);
+			}
+		}
+	}
+}
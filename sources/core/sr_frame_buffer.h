@@ -0,0 +1,440 @@
+#pragma once
+
+#include "core/sr_core_types.h"
+#include "core/sr_math.h"
+#include "core/sr_simd.h"
+
+namespace framebuffer
+{
+	/* pixel (x, y) of every per-pixel buffer, row-major or tile by tile with the pixels of a tile stored row by row */
+	inline int32_t PixelOffset(const FrameBuffer& frame_buffer, int32_t x, int32_t y);
+
+	/* row y of the FRAME_TILE_SIZE pixels starting at the aligned block_x, biased so that row[x] addresses pixel x of the row */
+	inline int32_t RowOffset(const FrameBuffer& frame_buffer, int32_t block_x, int32_t y);
+
+	/* inverse of PixelOffset */
+	inline Point PixelCoords(const FrameBuffer& frame_buffer, int32_t offset);
+
+	/* number of pixels a buffer of either layout needs, tiled buffers are padded to whole tiles */
+	int32_t GetBufferSize(int32_t width, int32_t height);
+
+	/* bytes per pixel of the color buffer */
+	int32_t GetColorSize(COLOR_FORMAT format);
+
+	/* unorm formats clamp colors to [0, 1], blending clamps the source color of those first */
+	inline bool IsUnormFormat(COLOR_FORMAT format);
+
+	/* color as the bits of one pixel of the format, channels the format lacks are dropped */
+	inline uint64_t PackColor(COLOR_FORMAT format, const math::Vector4& color);
+
+	/* colors of count pixels at the given offsets in the color format of the frame buffer, channels the format lacks load as 0 or alpha 1,
+	 * the format is resolved once per call and the pixels are packed four at a time */
+	void LoadColors(const FrameBuffer& frame_buffer, const int32_t* offsets, int32_t count, math::Vector4* colors);
+	void StoreColors(const FrameBuffer& frame_buffer, const int32_t* offsets, int32_t count, const math::Vector4* colors);
+
+	/* G-buffer normal, a unit vector octahedral encoded to two snorm16 that never pack to 0, so 0 marks an uncovered pixel */
+	inline uint32_t PackNormal(const math::Vector3& normal);
+	inline math::Vector3 UnpackNormal(uint32_t bits);
+
+	/* stores the same packed color into count consecutive pixels of dst */
+	void FillColor(COLOR_FORMAT format, uint8_t* dst, int32_t count, uint64_t color);
+
+	/* bytes per pixel of the depth buffer */
+	int32_t GetDepthSize(DEPTH_FORMAT format);
+
+	/* depth rounded to the precision of the depth format, tests compare it against stored depths so equal depths stay equal */
+	inline float QuantizeDepth(const FrameBuffer& frame_buffer, float depth);
+	inline simd::Float QuantizeDepth(const FrameBuffer& frame_buffer, simd::Float depth);
+
+	/* stored depth as NDC z, LoadDepths reads simd::WIDTH consecutive pixels */
+	inline float LoadDepth(const FrameBuffer& frame_buffer, int32_t offset);
+	inline simd::Float LoadDepths(const FrameBuffer& frame_buffer, int32_t offset);
+	inline void StoreDepth(const FrameBuffer& frame_buffer, int32_t offset, float depth);
+
+	/* writes the selected lanes of simd::WIDTH consecutive pixels, 16-bit depth writes the others back unchanged, so all of them must belong to the caller */
+	inline void StoreDepths(const FrameBuffer& frame_buffer, int32_t offset, simd::Float depth, int32_t lanes);
+
+	/* stores the same depth into count consecutive pixels */
+	void FillDepth(const FrameBuffer& frame_buffer, int32_t offset, int32_t count, float depth);
+
+	/* fills the pending clears of a tile about to be written, except the planes the caller overwrites in every pixel */
+	inline void TouchTile(const FrameBuffer& frame_buffer, int32_t tile_x, int32_t tile_y, uint8_t overwritten_planes);
+
+	/* writes the clear values of the given planes into every pixel of a tile */
+	void FillTile(const FrameBuffer& frame_buffer, int32_t tile_x, int32_t tile_y, uint8_t planes);
+
+	/* fills every tile with a pending clear of the given planes */
+	void FlushClears(const FrameBuffer& frame_buffer, uint8_t planes);
+
+	/* copies the colors into a row-major buffer of the same format, tiles with a pending color clear resolve to the clear color */
+	void ResolvePixels(const FrameBuffer& frame_buffer, uint8_t* dst);
+}
+
+int32_t framebuffer::PixelOffset(const FrameBuffer& frame_buffer, int32_t x, int32_t y)
+{
+	if (!frame_buffer.tiled)
+	{
+		return y * frame_buffer.width + x;
+	}
+
+	// Coordinates are never negative, unsigned math turns the divisions into shifts and masks
+	constexpr uint32_t TILE_SIZE = FRAME_TILE_SIZE;
+	const uint32_t ux = static_cast<uint32_t>(x);
+	const uint32_t uy = static_cast<uint32_t>(y);
+	const uint32_t num_tiles_x = (static_cast<uint32_t>(frame_buffer.width) + TILE_SIZE - 1) / TILE_SIZE;
+	const uint32_t tile_index = (uy / TILE_SIZE) * num_tiles_x + ux / TILE_SIZE;
+	return static_cast<int32_t>(tile_index * TILE_SIZE * TILE_SIZE + (uy % TILE_SIZE) * TILE_SIZE + ux % TILE_SIZE);
+}
+
+int32_t framebuffer::RowOffset(const FrameBuffer& frame_buffer, int32_t block_x, int32_t y)
+{
+	return PixelOffset(frame_buffer, block_x, y) - block_x;
+}
+
+Point framebuffer::PixelCoords(const FrameBuffer& frame_buffer, int32_t offset)
+{
+	if (!frame_buffer.tiled)
+	{
+		return Point{ offset % frame_buffer.width, offset / frame_buffer.width };
+	}
+
+	const int32_t num_tiles_x = (frame_buffer.width + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE;
+	const int32_t tile_index = offset / (FRAME_TILE_SIZE * FRAME_TILE_SIZE);
+	const int32_t tile_offset = offset % (FRAME_TILE_SIZE * FRAME_TILE_SIZE);
+	return Point{ (tile_index % num_tiles_x) * FRAME_TILE_SIZE + tile_offset % FRAME_TILE_SIZE, (tile_index / num_tiles_x) * FRAME_TILE_SIZE + tile_offset / FRAME_TILE_SIZE };
+}
+
+void framebuffer::TouchTile(const FrameBuffer& frame_buffer, int32_t tile_x, int32_t tile_y, uint8_t overwritten_planes)
+{
+	if (!frame_buffer.clear_state)
+	{
+		return;
+	}
+
+	const int32_t num_tiles_x = (frame_buffer.width + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE;
+	uint8_t& state = frame_buffer.clear_state[tile_y * num_tiles_x + tile_x];
+	if (state == 0)
+	{
+		return;
+	}
+
+	// A pending normal clear waits for the geometry pass, nothing else writes the normals
+	const uint8_t pending = frame_buffer.normal_buffer ? state : state & ~TILE_CLEAR_NORMAL;
+	const uint8_t planes = pending & ~overwritten_planes;
+	if (planes)
+	{
+		FillTile(frame_buffer, tile_x, tile_y, planes);
+	}
+
+	state &= ~pending;
+}
+
+/* Unorm depth, NDC z in [-1, 1] maps to [0, max_value] rounded to nearest, decoding maps it back */
+namespace framebuffer
+{
+	constexpr float D16_MAX = 65535.0f;
+	constexpr float D24_MAX = 16777215.0f;
+
+	inline uint32_t EncodeUnorm(float depth, float max_value);
+	inline float DecodeUnorm(uint32_t value, float max_value);
+	inline simd::Float EncodeUnorm(simd::Float depth, float max_value);
+	inline simd::Float QuantizeUnorm(simd::Float depth, float max_value);
+}
+
+uint32_t framebuffer::EncodeUnorm(float depth, float max_value)
+{
+	// Above 2^23 adding one half can round up past the largest value, so it is clamped again
+	const float value = math::Clamp((depth * 0.5f + 0.5f) * max_value, 0.0f, max_value);
+	return static_cast<uint32_t>(math::Min(value + 0.5f, max_value));
+}
+
+float framebuffer::DecodeUnorm(uint32_t value, float max_value)
+{
+	return static_cast<float>(value) * (2.0f / max_value) - 1.0f;
+}
+
+simd::Float framebuffer::EncodeUnorm(simd::Float depth, float max_value)
+{
+	// Same steps as the scalar EncodeUnorm, truncation rounds since the value is never negative
+	const simd::Float half = simd::Set(0.5f);
+	const simd::Float max = simd::Set(max_value);
+	const simd::Float value = simd::Min(simd::Max(simd::Mul(simd::Add(simd::Mul(depth, half), half), max), simd::Set(0.0f)), max);
+	return simd::Truncate(simd::Min(simd::Add(value, half), max));
+}
+
+simd::Float framebuffer::QuantizeUnorm(simd::Float depth, float max_value)
+{
+	return simd::Sub(simd::Mul(EncodeUnorm(depth, max_value), simd::Set(2.0f / max_value)), simd::Set(1.0f));
+}
+
+float framebuffer::QuantizeDepth(const FrameBuffer& frame_buffer, float depth)
+{
+	switch (frame_buffer.depth_format)
+	{
+	case DEPTH_FORMAT::D16_UNORM:
+		return DecodeUnorm(EncodeUnorm(depth, D16_MAX), D16_MAX);
+	case DEPTH_FORMAT::D24_UNORM:
+		return DecodeUnorm(EncodeUnorm(depth, D24_MAX), D24_MAX);
+	default:
+		return depth;
+	}
+}
+
+simd::Float framebuffer::QuantizeDepth(const FrameBuffer& frame_buffer, simd::Float depth)
+{
+	switch (frame_buffer.depth_format)
+	{
+	case DEPTH_FORMAT::D16_UNORM:
+		return QuantizeUnorm(depth, D16_MAX);
+	case DEPTH_FORMAT::D24_UNORM:
+		return QuantizeUnorm(depth, D24_MAX);
+	default:
+		return depth;
+	}
+}
+
+float framebuffer::LoadDepth(const FrameBuffer& frame_buffer, int32_t offset)
+{
+	switch (frame_buffer.depth_format)
+	{
+	case DEPTH_FORMAT::D16_UNORM:
+		return DecodeUnorm(reinterpret_cast<const uint16_t*>(frame_buffer.depth_buffer)[offset], D16_MAX);
+	case DEPTH_FORMAT::D24_UNORM:
+		return DecodeUnorm(reinterpret_cast<const uint32_t*>(frame_buffer.depth_buffer)[offset] & 0xffffff, D24_MAX);
+	default:
+		return reinterpret_cast<const float*>(frame_buffer.depth_buffer)[offset];
+	}
+}
+
+simd::Float framebuffer::LoadDepths(const FrameBuffer& frame_buffer, int32_t offset)
+{
+	switch (frame_buffer.depth_format)
+	{
+	case DEPTH_FORMAT::D16_UNORM:
+		return simd::Sub(simd::Mul(simd::LoadUInt16(reinterpret_cast<const uint16_t*>(frame_buffer.depth_buffer) + offset), simd::Set(2.0f / D16_MAX)), simd::Set(1.0f));
+	case DEPTH_FORMAT::D24_UNORM:
+		return simd::Sub(simd::Mul(simd::LoadUInt24(reinterpret_cast<const uint32_t*>(frame_buffer.depth_buffer) + offset), simd::Set(2.0f / D24_MAX)), simd::Set(1.0f));
+	default:
+		return simd::Load(reinterpret_cast<const float*>(frame_buffer.depth_buffer) + offset);
+	}
+}
+
+void framebuffer::StoreDepth(const FrameBuffer& frame_buffer, int32_t offset, float depth)
+{
+	switch (frame_buffer.depth_format)
+	{
+	case DEPTH_FORMAT::D16_UNORM:
+		reinterpret_cast<uint16_t*>(frame_buffer.depth_buffer)[offset] = static_cast<uint16_t>(EncodeUnorm(depth, D16_MAX));
+		break;
+	case DEPTH_FORMAT::D24_UNORM:
+		reinterpret_cast<uint32_t*>(frame_buffer.depth_buffer)[offset] = EncodeUnorm(depth, D24_MAX);
+		break;
+	default:
+		reinterpret_cast<float*>(frame_buffer.depth_buffer)[offset] = depth;
+		break;
+	}
+}
+
+void framebuffer::StoreDepths(const FrameBuffer& frame_buffer, int32_t offset, simd::Float depth, int32_t lanes)
+{
+	switch (frame_buffer.depth_format)
+	{
+	case DEPTH_FORMAT::D16_UNORM:
+		simd::StoreUInt16(reinterpret_cast<uint16_t*>(frame_buffer.depth_buffer) + offset, EncodeUnorm(depth, D16_MAX), lanes);
+		break;
+	case DEPTH_FORMAT::D24_UNORM:
+		simd::StoreUInt32(reinterpret_cast<uint32_t*>(frame_buffer.depth_buffer) + offset, EncodeUnorm(depth, D24_MAX), lanes);
+		break;
+	default:
+		simd::Store(reinterpret_cast<float*>(frame_buffer.depth_buffer) + offset, depth, lanes);
+		break;
+	}
+}
+
+/* Pack kernels, one SSE register holds the four channels of a pixel, the x4 variants handle four pixels with one packed pixel per lane */
+namespace framebuffer
+{
+	inline __m128 SaturateChannels(__m128 value);
+	inline uint32_t PackUnorm8(__m128 value);
+	inline __m128 UnpackUnorm8(uint32_t bits);
+	inline __m128i PackUnorm8x4(const __m128 values[4]);
+	inline void UnpackUnorm8x4(__m128i bits, __m128 values[4]);
+	inline uint32_t PackUnorm10(__m128 value);
+	inline __m128 UnpackUnorm10(uint32_t bits);
+	inline __m128i PackUnorm10x4(const __m128 values[4]);
+	inline uint64_t PackHalf(__m128 value);
+	inline __m128 UnpackHalf(uint64_t bits);
+	inline void PackHalfx4(const __m128 values[4], uint64_t bits[4]);
+}
+
+__m128 framebuffer::SaturateChannels(__m128 value)
+{
+	return _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+uint32_t framebuffer::PackUnorm8(__m128 value)
+{
+	// Truncates like math::FloatToUChar
+	const __m128i channels = _mm_cvttps_epi32(_mm_mul_ps(SaturateChannels(value), _mm_set1_ps(255.0f)));
+	const __m128i words = _mm_packs_epi32(channels, channels);
+	return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+}
+
+__m128 framebuffer::UnpackUnorm8(uint32_t bits)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bytes = _mm_cvtsi32_si128(static_cast<int32_t>(bits));
+	const __m128i dwords = _mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero);
+	return _mm_mul_ps(_mm_cvtepi32_ps(dwords), _mm_set1_ps(1.0f / 255.0f));
+}
+
+__m128i framebuffer::PackUnorm8x4(const __m128 values[4])
+{
+	const __m128 scale = _mm_set1_ps(255.0f);
+	const __m128i channels0 = _mm_cvttps_epi32(_mm_mul_ps(SaturateChannels(values[0]), scale));
+	const __m128i channels1 = _mm_cvttps_epi32(_mm_mul_ps(SaturateChannels(values[1]), scale));
+	const __m128i channels2 = _mm_cvttps_epi32(_mm_mul_ps(SaturateChannels(values[2]), scale));
+	const __m128i channels3 = _mm_cvttps_epi32(_mm_mul_ps(SaturateChannels(values[3]), scale));
+	return _mm_packus_epi16(_mm_packs_epi32(channels0, channels1), _mm_packs_epi32(channels2, channels3));
+}
+
+void framebuffer::UnpackUnorm8x4(__m128i bits, __m128 values[4])
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+	const __m128i words01 = _mm_unpacklo_epi8(bits, zero);
+	const __m128i words23 = _mm_unpackhi_epi8(bits, zero);
+	values[0] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words01, zero)), scale);
+	values[1] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(words01, zero)), scale);
+	values[2] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words23, zero)), scale);
+	values[3] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(words23, zero)), scale);
+}
+
+uint32_t framebuffer::PackUnorm10(__m128 value)
+{
+	alignas(16) uint32_t channels[4];
+	_mm_store_si128(reinterpret_cast<__m128i*>(channels), _mm_cvttps_epi32(_mm_mul_ps(SaturateChannels(value), _mm_setr_ps(1023.0f, 1023.0f, 1023.0f, 3.0f))));
+	return channels[0] | (channels[1] << 10) | (channels[2] << 20) | (channels[3] << 30);
+}
+
+__m128 framebuffer::UnpackUnorm10(uint32_t bits)
+{
+	const __m128i fields = _mm_setr_epi32(static_cast<int32_t>(bits & 0x3ff), static_cast<int32_t>((bits >> 10) & 0x3ff), static_cast<int32_t>((bits >> 20) & 0x3ff), static_cast<int32_t>(bits >> 30));
+	return _mm_mul_ps(_mm_cvtepi32_ps(fields), _mm_setr_ps(1.0f / 1023.0f, 1.0f / 1023.0f, 1.0f / 1023.0f, 1.0f / 3.0f));
+}
+
+__m128i framebuffer::PackUnorm10x4(const __m128 values[4])
+{
+	// One channel of the four pixels per register
+	__m128 r = values[0];
+	__m128 g = values[1];
+	__m128 b = values[2];
+	__m128 a = values[3];
+	_MM_TRANSPOSE4_PS(r, g, b, a);
+
+	const __m128 scale = _mm_set1_ps(1023.0f);
+	const __m128i red = _mm_cvttps_epi32(_mm_mul_ps(SaturateChannels(r), scale));
+	const __m128i green = _mm_cvttps_epi32(_mm_mul_ps(SaturateChannels(g), scale));
+	const __m128i blue = _mm_cvttps_epi32(_mm_mul_ps(SaturateChannels(b), scale));
+	const __m128i alpha = _mm_cvttps_epi32(_mm_mul_ps(SaturateChannels(a), _mm_set1_ps(3.0f)));
+	return _mm_or_si128(_mm_or_si128(red, _mm_slli_epi32(green, 10)), _mm_or_si128(_mm_slli_epi32(blue, 20), _mm_slli_epi32(alpha, 30)));
+}
+
+uint64_t framebuffer::PackHalf(__m128 value)
+{
+	uint64_t bits;
+#if defined(__AVX2__)
+	_mm_storel_epi64(reinterpret_cast<__m128i*>(&bits), _mm_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT));
+#else
+	alignas(16) float channels[4];
+	_mm_store_ps(channels, value);
+	bits = 0;
+	for (int32_t i = 0; i < 4; ++i)
+	{
+		bits |= static_cast<uint64_t>(math::FloatToHalf(channels[i])) << (i * 16);
+	}
+#endif
+	return bits;
+}
+
+__m128 framebuffer::UnpackHalf(uint64_t bits)
+{
+#if defined(__AVX2__)
+	return _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&bits)));
+#else
+	return _mm_setr_ps(
+		math::FloatFromHalf(static_cast<uint16_t>(bits)),
+		math::FloatFromHalf(static_cast<uint16_t>(bits >> 16)),
+		math::FloatFromHalf(static_cast<uint16_t>(bits >> 32)),
+		math::FloatFromHalf(static_cast<uint16_t>(bits >> 48)));
+#endif
+}
+
+void framebuffer::PackHalfx4(const __m128 values[4], uint64_t bits[4])
+{
+#if defined(__AVX2__)
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(bits), _mm256_cvtps_ph(_mm256_set_m128(values[1], values[0]), _MM_FROUND_TO_NEAREST_INT));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(bits + 2), _mm256_cvtps_ph(_mm256_set_m128(values[3], values[2]), _MM_FROUND_TO_NEAREST_INT));
+#else
+	for (int32_t i = 0; i < 4; ++i)
+	{
+		bits[i] = PackHalf(values[i]);
+	}
+#endif
+}
+
+bool framebuffer::IsUnormFormat(COLOR_FORMAT format)
+{
+	return format != COLOR_FORMAT::RGBA16_FLOAT && format != COLOR_FORMAT::R32_FLOAT;
+}
+
+uint64_t framebuffer::PackColor(COLOR_FORMAT format, const math::Vector4& color)
+{
+	const __m128 value = _mm_loadu_ps(&color.x);
+	switch (format)
+	{
+	case COLOR_FORMAT::RGBA8_UNORM:
+		return PackUnorm8(value);
+	case COLOR_FORMAT::BGRA8_UNORM:
+		return PackUnorm8(_mm_shuffle_ps(value, value, _MM_SHUFFLE(3, 0, 1, 2)));
+	case COLOR_FORMAT::RGB10A2_UNORM:
+		return PackUnorm10(value);
+	case COLOR_FORMAT::RGBA16_FLOAT:
+		return PackHalf(value);
+	default:
+		return std::bit_cast<uint32_t>(color.x);
+	}
+}
+
+uint32_t framebuffer::PackNormal(const math::Vector3& normal)
+{
+	// Project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the diagonals
+	const float inv_length = 1.0f / (fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z));
+	float x = normal.x * inv_length;
+	float y = normal.y * inv_length;
+	if (normal.z < 0.0f)
+	{
+		const float folded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		const float folded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = folded_x;
+		y = folded_y;
+	}
+
+	// [-1, 1] -> [1, 65535]
+	const uint32_t encoded_x = static_cast<uint32_t>(lrintf(math::Clamp(x, -1.0f, 1.0f) * 32767.0f) + 32768);
+	const uint32_t encoded_y = static_cast<uint32_t>(lrintf(math::Clamp(y, -1.0f, 1.0f) * 32767.0f) + 32768);
+	return encoded_x | (encoded_y << 16);
+}
+
+math::Vector3 framebuffer::UnpackNormal(uint32_t bits)
+{
+	float x = static_cast<float>(static_cast<int32_t>(bits & 0xFFFF) - 32768) * (1.0f / 32767.0f);
+	float y = static_cast<float>(static_cast<int32_t>(bits >> 16) - 32768) * (1.0f / 32767.0f);
+	const float z = 1.0f - fabsf(x) - fabsf(y);
+
+	// Unfold the lower half
+	const float fold = math::Max(-z, 0.0f);
+	x += x >= 0.0f ? -fold : fold;
+	y += y >= 0.0f ? -fold : fold;
+	return math::Vector3Normalize(math::Vector3(x, y, z));
+}
@@ -1,24 +1,100 @@
 #include "sr_pch.h"
 #include "core/sr_graphic_device.h"
-#include "core/sr_rasterizer.h"
+#include "core/sr_frame_arena.h"
+#include "core/sr_frame_buffer.h"
+#include "core/sr_job_system.h"
+#include "core/sr_light_culling.h"
+#include "core/sr_texture.h"
+#include "core/sr_tile_renderer.h"
+#include "core/sr_visibility_renderer.h"
+#include "shaders/sr_blinn_phong_shader.h"
 #include "shaders/sr_flat_shader.h"
+#include "shaders/sr_forward_plus_shader.h"
+#include "shaders/sr_gouraud_shader.h"
+#include "shaders/sr_phong_shader.h"
+#include "shaders/sr_textured_shader.h"
 
 GraphicDevice::GraphicDevice()
 	: width_(800)
 	, height_(600)
 	, shader_(nullptr)
+	, rasterize_function_(rasterizer::RasterizeTriangle_V3)
+	, stats_()
 {
-	const int32_t buffer_bytes = width_ * height_ * 4;
-	pixel_buffer_ = reinterpret_cast<uint8_t*>(malloc(buffer_bytes));
-	depth_buffer_ = reinterpret_cast<float*>(malloc(buffer_bytes));
-
-	pipeline_context_ = CreatePipelineContext(sizeof(FlatAttributeData), sizeof(FlatVertexData), sizeof(FlatConstantData), false, false);
+	// Sized for the tiled layout, which pads the last row and column of tiles, so both layouts fit
+	num_buffer_pixels_ = framebuffer::GetBufferSize(width_, height_);
+	// Colors are sized for the widest format, 64-bit RGBA16_FLOAT
+	const int32_t buffer_bytes = num_buffer_pixels_ * 4;
+	pixel_buffer_ = reinterpret_cast<uint8_t*>(_mm_malloc(buffer_bytes * 2, 64));
+	color_format_ = COLOR_FORMAT::RGBA8_UNORM;
+	depth_buffer_ = _mm_malloc(buffer_bytes, 64);
+	depth_format_ = DEPTH_FORMAT::D32_FLOAT;
+	resolve_buffer_ = reinterpret_cast<uint8_t*>(malloc(width_ * height_ * 8));
+	tiled_frame_buffer_ = false;
+
+	const int32_t num_hiz_tiles_x = (width_ + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+	const int32_t num_hiz_tiles_y = (height_ + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+	num_hiz_tiles_ = num_hiz_tiles_x * num_hiz_tiles_y;
+	hiz_buffer_ = reinterpret_cast<float*>(malloc(num_hiz_tiles_ * sizeof(float)));
+	hiz_dirty_ = reinterpret_cast<uint8_t*>(malloc(num_hiz_tiles_));
+
+	// Frame buffer tiles and hierarchical depth tiles are the same 8x8 pixels
+	clear_state_ = reinterpret_cast<uint8_t*>(malloc(num_hiz_tiles_));
+	memset(clear_state_, 0, num_hiz_tiles_);
+	clear_color_ = 0;
+	clear_depth_ = 1.0f;
+
+	gbuffer_albedo_ = reinterpret_cast<uint8_t*>(_mm_malloc(buffer_bytes, 64));
+	gbuffer_normal_ = reinterpret_cast<uint32_t*>(_mm_malloc(buffer_bytes, 64));
+	memset(gbuffer_normal_, 0, buffer_bytes);
+
+	visibility_buffer_ = reinterpret_cast<uint32_t*>(_mm_malloc(buffer_bytes, 64));
+
+	cull_mode_ = CULL_MODE::BACK;
+	front_face_ = FRONT_FACE::COUNTER_CLOCKWISE;
+	two_sided_ = false;
+	depth_test_ = true;
+	depth_write_ = true;
+	depth_func_ = DEPTH_FUNC::LESS_EQUAL;
+	enable_blend_ = false;
+	pipeline_context_ = CreatePipelineContext(sizeof(FlatAttributeData), sizeof(FlatVertexData), sizeof(FlatConstantData));
+
+	const int32_t num_threads = math::Max(static_cast<int32_t>(std::thread::hardware_concurrency()), 1);
+	job_system_ = new JobSystem(num_threads);
+	frame_arena_ = new FrameArena(num_threads);
+	in_frame_ = false;
+	vertex_clip_coords_ = nullptr;
+	vertex_varyings_ = nullptr;
+	num_shaded_vertices_ = 0;
+
+	tile_renderer_ = new TileRenderer(job_system_, frame_arena_, width_, height_);
+	tiled_rendering_ = num_threads > 1;
+
+	visibility_renderer_ = new VisibilityRenderer(job_system_, frame_arena_);
+	visibility_rendering_ = false;
+	ClearVisibilityBuffer();
+
+	light_culler_ = new LightCuller(job_system_, frame_arena_, width_, height_);
+	depth_only_ = false;
 }
 
 GraphicDevice::~GraphicDevice()
 {
-	free(pixel_buffer_);
-	free(depth_buffer_);
+	delete light_culler_;
+	delete visibility_renderer_;
+	delete tile_renderer_;
+	delete frame_arena_;
+	delete job_system_;
+
+	_mm_free(pixel_buffer_);
+	_mm_free(depth_buffer_);
+	free(resolve_buffer_);
+	free(hiz_buffer_);
+	free(hiz_dirty_);
+	free(clear_state_);
+	_mm_free(gbuffer_albedo_);
+	_mm_free(gbuffer_normal_);
+	_mm_free(visibility_buffer_);
 
 	ReleasePipelineContext(pipeline_context_);
 }
@@ -33,6 +109,21 @@ void GraphicDevice::Finalize()
 	DeleteShader();
 }
 
+void GraphicDevice::BeginFrame()
+{
+	visibility_renderer_->Reset();
+	frame_arena_->Reset();
+	vertex_clip_coords_ = nullptr;
+	vertex_varyings_ = nullptr;
+	num_shaded_vertices_ = 0;
+	in_frame_ = true;
+}
+
+FrameArenaStats GraphicDevice::GetFrameArenaStats() const
+{
+	return frame_arena_->GetStats();
+}
+
 int32_t GraphicDevice::GetWidth() const
 {
 	return width_;
@@ -48,57 +139,259 @@ uint8_t* GraphicDevice::GetPixelBuffer() const
 	return pixel_buffer_;
 }
 
-float* GraphicDevice::GetDepthBuffer() const
+void* GraphicDevice::GetDepthBuffer() const
 {
 	return depth_buffer_;
 }
 
+void GraphicDevice::EndFrame()
+{
+	SR_ASSERT(in_frame_);
+	in_frame_ = false;
+
+	// Row-major colors are already in place once the pending clears are filled
+	if (!tiled_frame_buffer_)
+	{
+		framebuffer::FlushClears(MakeFrameBuffer(), TILE_CLEAR_COLOR);
+		return;
+	}
+
+	framebuffer::ResolvePixels(MakeFrameBuffer(), resolve_buffer_);
+}
+
+const uint8_t* GraphicDevice::ResolvePixelBuffer() const
+{
+	return tiled_frame_buffer_ ? resolve_buffer_ : pixel_buffer_;
+}
+
+void GraphicDevice::FlushClears()
+{
+	framebuffer::FlushClears(MakeFrameBuffer(), TILE_CLEAR_COLOR | TILE_CLEAR_DEPTH);
+}
+
+void GraphicDevice::SetTiledFrameBuffer(bool enable)
+{
+	tiled_frame_buffer_ = enable;
+}
+
+bool GraphicDevice::IsTiledFrameBuffer() const
+{
+	return tiled_frame_buffer_;
+}
+
+void GraphicDevice::SetColorFormat(COLOR_FORMAT color_format)
+{
+	color_format_ = color_format;
+}
+
+COLOR_FORMAT GraphicDevice::GetColorFormat() const
+{
+	return color_format_;
+}
+
+void GraphicDevice::SetDepthFormat(DEPTH_FORMAT depth_format)
+{
+	depth_format_ = depth_format;
+}
+
+DEPTH_FORMAT GraphicDevice::GetDepthFormat() const
+{
+	return depth_format_;
+}
+
 void GraphicDevice::ClearPixelBuffer(const math::Vector4& clear_color)
 {
-	const uint8_t r = math::FloatToUChar(clear_color.x);
-	const uint8_t g = math::FloatToUChar(clear_color.y);
-	const uint8_t b = math::FloatToUChar(clear_color.z);
-	const uint8_t a = math::FloatToUChar(clear_color.w);
-	const uint32_t color = (a << 24) | (b << 16) | (g << 8) | r;
-	const int32_t num_pixels = width_ * height_;
-	CopyBuffer(reinterpret_cast<uint32_t*>(pixel_buffer_), color, num_pixels);
+	clear_color_ = framebuffer::PackColor(color_format_, clear_color);
+	MarkClear(TILE_CLEAR_COLOR);
 }
 
 void GraphicDevice::ClearDepthBuffer(float clear_depth)
 {
-	const int32_t num_pixels = width_ * height_;
-	CopyBuffer(depth_buffer_, clear_depth, num_pixels);
+	// Rounded to the depth format, so the clear value compares equal to the depth stored in cleared tiles
+	clear_depth_ = framebuffer::QuantizeDepth(MakeFrameBuffer(), clear_depth);
+	MarkClear(TILE_CLEAR_DEPTH);
+
+	// Every tile of the hierarchical depth is exact right after a clear
+	CopyBuffer(hiz_buffer_, clear_depth_, num_hiz_tiles_);
+	memset(hiz_dirty_, 0, num_hiz_tiles_);
+}
+
+void GraphicDevice::MarkClear(uint8_t planes)
+{
+	// Tiles pick up the new clear value when they are filled, a plane cleared twice is filled once
+	for (int32_t i = 0; i < num_hiz_tiles_; ++i)
+	{
+		clear_state_[i] |= planes;
+	}
+}
+
+void GraphicDevice::ClearGBuffer()
+{
+	// Only the coverage of the normals matters, albedo of uncovered pixels is never read
+	MarkClear(TILE_CLEAR_NORMAL);
+}
+
+void GraphicDevice::LightGBuffer()
+{
+	SR_ASSERT(shader_ && shader_->IsDeferred());
+
+	// Lighting only writes covered pixels, the rest keeps the clear color
+	framebuffer::FlushClears(MakeFrameBuffer(), TILE_CLEAR_COLOR);
+
+	// Every pixel is lit by exactly one job, so tiles need no synchronization
+	const int32_t num_tiles_x = (width_ + TileRenderer::TILE_SIZE - 1) / TileRenderer::TILE_SIZE;
+	const int32_t num_tiles_y = (height_ + TileRenderer::TILE_SIZE - 1) / TileRenderer::TILE_SIZE;
+	job_system_->ParallelFor(num_tiles_x * num_tiles_y, [this, num_tiles_x](int32_t tile_index, int32_t thread_index)
+	{
+		LightTile(tile_index % num_tiles_x, tile_index / num_tiles_x);
+	});
 }
 
-PipelineContext* GraphicDevice::CreatePipelineContext(int32_t sizeof_attributes, int32_t sizeof_varyings, int32_t sizeof_constants, bool two_sided, bool enable_blend)
+VertexBuffer* GraphicDevice::CreateVertexBuffer(const void* vertices, int32_t sizeof_vertex, int32_t num_vertices)
+{
+	SR_ASSERT(vertices);
+	SR_ASSERT(sizeof_vertex > 0 && num_vertices > 0);
+
+	VertexBuffer* vertex_buffer = reinterpret_cast<VertexBuffer*>(malloc(sizeof(VertexBuffer)));
+	SR_ASSERT(vertex_buffer);
+
+	vertex_buffer->vertices = reinterpret_cast<uint8_t*>(malloc(sizeof_vertex * num_vertices));
+	SR_ASSERT(vertex_buffer->vertices);
+	memcpy(vertex_buffer->vertices, vertices, sizeof_vertex * num_vertices);
+
+	vertex_buffer->sizeof_vertex = sizeof_vertex;
+	vertex_buffer->num_vertices = num_vertices;
+	return vertex_buffer;
+}
+
+void GraphicDevice::ReleaseVertexBuffer(VertexBuffer* vertex_buffer)
+{
+	SR_ASSERT(vertex_buffer);
+
+	free(vertex_buffer->vertices);
+	free(vertex_buffer);
+}
+
+IndexBuffer* GraphicDevice::CreateIndexBuffer(const uint32_t* indices, int32_t num_indices)
+{
+	SR_ASSERT(indices);
+	SR_ASSERT(num_indices > 0);
+
+	IndexBuffer* index_buffer = reinterpret_cast<IndexBuffer*>(malloc(sizeof(IndexBuffer)));
+	SR_ASSERT(index_buffer);
+
+	index_buffer->indices = reinterpret_cast<uint32_t*>(malloc(sizeof(uint32_t) * num_indices));
+	SR_ASSERT(index_buffer->indices);
+	memcpy(index_buffer->indices, indices, sizeof(uint32_t) * num_indices);
+
+	index_buffer->num_indices = num_indices;
+	return index_buffer;
+}
+
+void GraphicDevice::ReleaseIndexBuffer(IndexBuffer* index_buffer)
+{
+	SR_ASSERT(index_buffer);
+
+	free(index_buffer->indices);
+	free(index_buffer);
+}
+
+Texture2D* GraphicDevice::CreateTexture2D(const char* filename)
+{
+	SR_ASSERT(filename);
+
+	int32_t width = 0;
+	int32_t height = 0;
+	int32_t num_channels = 0;
+	uint8_t* pixels = stbi_load(filename, &width, &height, &num_channels, 4);
+	if (!pixels)
+	{
+		return nullptr;
+	}
+
+	Texture2D* texture = CreateTexture2D(pixels, width, height);
+	stbi_image_free(pixels);
+	return texture;
+}
+
+Texture2D* GraphicDevice::CreateTexture2D(const uint8_t* pixels, int32_t width, int32_t height)
+{
+	SR_ASSERT(pixels);
+	SR_ASSERT(width > 0 && height > 0);
+
+	// The texture and all of its levels share one allocation, the texels start on the cache line after the texture
+	Texture2D levels;
+	const int32_t num_texels = texture::MakeLevels(levels, width, height);
+	const size_t sizeof_texture = (sizeof(Texture2D) + 63) & ~static_cast<size_t>(63);
+	uint8_t* memory = reinterpret_cast<uint8_t*>(_mm_malloc(sizeof_texture + num_texels * sizeof(uint32_t), 64));
+	SR_ASSERT(memory);
+
+	Texture2D* texture = reinterpret_cast<Texture2D*>(memory);
+	*texture = levels;
+	texture::StoreTexels(*texture, reinterpret_cast<uint32_t*>(memory + sizeof_texture), pixels);
+	return texture;
+}
+
+void GraphicDevice::ReleaseTexture2D(Texture2D* texture)
+{
+	SR_ASSERT(texture);
+
+	_mm_free(texture);
+}
+
+PipelineContext* GraphicDevice::CreatePipelineContext(int32_t sizeof_attributes, int32_t sizeof_varyings, int32_t sizeof_constants)
 {
 	SR_ASSERT(sizeof_varyings > 0);
 	SR_ASSERT(sizeof_varyings % sizeof(float) == 0);
 
-	PipelineContext* context = reinterpret_cast<PipelineContext*>(malloc(sizeof(PipelineContext)));
-	SR_ASSERT(context);
-	memset(context, 0, sizeof(PipelineContext));
+	// The context and all of its blocks share one allocation, every block starts on its own cache line
+	const auto align = [](size_t size) { return (size + 63) & ~static_cast<size_t>(63); };
+	const size_t sizeof_context = align(sizeof(PipelineContext));
+	const size_t sizeof_block_attributes = align(sizeof_attributes);
+	const size_t sizeof_block_varyings = align(sizeof_varyings * PIXEL_BATCH_SIZE);
+	const size_t sizeof_block_derivatives = align(sizeof_varyings * PIXEL_BATCH_SIZE * 2);
+	const size_t sizeof_block_constants = align(sizeof_constants);
+	const size_t sizeof_block_clip_varyings = align(sizeof_varyings * rasterizer::MAX_CLIP_VARYINGS);
+	const size_t total_size = sizeof_context + sizeof_block_attributes * 3 + sizeof_block_varyings + sizeof_block_derivatives + sizeof_block_constants + sizeof_block_clip_varyings;
+
+	uint8_t* memory = reinterpret_cast<uint8_t*>(_mm_malloc(total_size, 64));
+	SR_ASSERT(memory);
+	memset(memory, 0, total_size);
+
+	PipelineContext* context = reinterpret_cast<PipelineContext*>(memory);
+	memory += sizeof_context;
 
 	context->sizeof_attributes = sizeof_attributes;
 	context->sizeof_varyings = sizeof_varyings;
 	context->sizeof_constants = sizeof_constants;
-	context->two_sided = two_sided;
-	context->enable_blend = enable_blend;
+	context->two_sided = two_sided_;
+	context->enable_blend = enable_blend_;
+	context->cull_mode = cull_mode_;
+	context->front_face = front_face_;
+	context->depth_test = depth_test_;
+	context->depth_write = depth_write_;
+	context->depth_func = depth_func_;
 
 	for (int32_t i = 0; i < 3; ++i)
 	{
-		context->shader_attributes[i] = malloc(sizeof_attributes);
-		SR_ASSERT(context->shader_attributes[i]);
-		memset(context->shader_attributes[i], 0, sizeof_attributes);
+		context->shader_attributes[i] = memory;
+		memory += sizeof_block_attributes;
 	}
 
-	context->shader_varyings = malloc(sizeof_varyings);
-	SR_ASSERT(context->shader_varyings);
-	memset(context->shader_varyings, 0, sizeof_varyings);
+	// Pixels are shaded in batches, with the varyings of a batch stored per component,
+	// components the shader does not declare are never written and keep the zeros of the memset above
+	context->shader_varyings = memory;
+	memory += sizeof_block_varyings;
+
+	// Screen-space derivatives of a batch, all x derivatives followed by all y derivatives
+	context->shader_derivatives = memory;
+	memory += sizeof_block_derivatives;
 
-	context->shader_constants = malloc(sizeof_constants);
-	SR_ASSERT(context->shader_constants);
-	memset(context->shader_constants, 0, sizeof_constants);
+	context->shader_constants = memory;
+	memory += sizeof_block_constants;
+
+	// Scratch varyings for the vertices created by clipping
+	context->clip_varyings = memory;
 
 	return context;
 }
@@ -107,31 +400,41 @@ void GraphicDevice::ReleasePipelineContext(PipelineContext* context)
 {
 	SR_ASSERT(context);
 
-	for (int32_t i = 0; i < 3; ++i)
-	{
-		free(context->shader_attributes[i]);
-	}
-
-	free(context->shader_varyings);
-	free(context->shader_constants);
-
-	free(context);
+	// The blocks live in the allocation of the context
+	_mm_free(context);
 }
 
 IShader* GraphicDevice::SelectShader(SHADER_MODE mode)
 {
 	DeleteShader();
 
+	// The pipeline context is sized for the attributes, varyings and constants of the shader
+	ReleasePipelineContext(pipeline_context_);
 	switch (mode)
 	{
 	case SHADER_MODE::FLAT:
 		shader_ = new FlatShader();
+		pipeline_context_ = CreatePipelineContext(sizeof(FlatAttributeData), sizeof(FlatVertexData), sizeof(FlatConstantData));
 		break;
 	case SHADER_MODE::GOURAUD:
+		shader_ = new GouraudShader();
+		pipeline_context_ = CreatePipelineContext(sizeof(LitAttributeData), sizeof(GouraudVertexData), sizeof(LitConstantData));
 		break;
 	case SHADER_MODE::PHONG:
+		shader_ = new PhongShader();
+		pipeline_context_ = CreatePipelineContext(sizeof(LitAttributeData), sizeof(LitVertexData), sizeof(LitConstantData));
 		break;
 	case SHADER_MODE::BLINN_PHONG:
+		shader_ = new BlinnPhongShader();
+		pipeline_context_ = CreatePipelineContext(sizeof(LitAttributeData), sizeof(LitVertexData), sizeof(LitConstantData));
+		break;
+	case SHADER_MODE::FORWARD_PLUS:
+		shader_ = new ForwardPlusShader();
+		pipeline_context_ = CreatePipelineContext(sizeof(LitAttributeData), sizeof(ForwardPlusVertexData), sizeof(ForwardPlusConstantData));
+		break;
+	case SHADER_MODE::TEXTURED:
+		shader_ = new TexturedShader();
+		pipeline_context_ = CreatePipelineContext(sizeof(TexturedAttributeData), sizeof(TexturedVertexData), sizeof(TexturedConstantData));
 		break;
 	}
 
@@ -152,28 +455,426 @@ IShader* GraphicDevice::GetShader() const
 	return shader_;
 }
 
-void GraphicDevice::Draw()
+void GraphicDevice::SetShaderConstants(const void* constants)
+{
+	SR_ASSERT(constants);
+	memcpy(pipeline_context_->shader_constants, constants, pipeline_context_->sizeof_constants);
+}
+
+void GraphicDevice::SetCullMode(CULL_MODE cull_mode)
+{
+	cull_mode_ = cull_mode;
+	pipeline_context_->cull_mode = cull_mode;
+}
+
+CULL_MODE GraphicDevice::GetCullMode() const
+{
+	return cull_mode_;
+}
+
+void GraphicDevice::SetFrontFace(FRONT_FACE front_face)
+{
+	front_face_ = front_face;
+	pipeline_context_->front_face = front_face;
+}
+
+FRONT_FACE GraphicDevice::GetFrontFace() const
+{
+	return front_face_;
+}
+
+void GraphicDevice::SetTwoSided(bool enable)
+{
+	two_sided_ = enable;
+	pipeline_context_->two_sided = enable;
+}
+
+bool GraphicDevice::IsTwoSided() const
+{
+	return two_sided_;
+}
+
+void GraphicDevice::SetDepthTest(bool enable)
+{
+	depth_test_ = enable;
+	pipeline_context_->depth_test = enable;
+}
+
+bool GraphicDevice::IsDepthTest() const
+{
+	return depth_test_;
+}
+
+void GraphicDevice::SetDepthWrite(bool enable)
+{
+	depth_write_ = enable;
+	pipeline_context_->depth_write = enable;
+}
+
+bool GraphicDevice::IsDepthWrite() const
+{
+	return depth_write_;
+}
+
+void GraphicDevice::SetDepthFunc(DEPTH_FUNC depth_func)
+{
+	depth_func_ = depth_func;
+	pipeline_context_->depth_func = depth_func;
+}
+
+DEPTH_FUNC GraphicDevice::GetDepthFunc() const
+{
+	return depth_func_;
+}
+
+void GraphicDevice::SetBlend(bool enable)
+{
+	enable_blend_ = enable;
+	pipeline_context_->enable_blend = enable;
+}
+
+bool GraphicDevice::IsBlend() const
+{
+	return enable_blend_;
+}
+
+void GraphicDevice::SetTiledRendering(bool enable)
+{
+	tiled_rendering_ = enable;
+}
+
+bool GraphicDevice::IsTiledRendering() const
+{
+	return tiled_rendering_;
+}
+
+void GraphicDevice::SetVisibilityRendering(bool enable)
+{
+	visibility_rendering_ = enable;
+}
+
+bool GraphicDevice::IsVisibilityRendering() const
+{
+	return visibility_rendering_;
+}
+
+void GraphicDevice::ClearVisibilityBuffer()
+{
+	CopyBuffer(visibility_buffer_, VisibilityRenderer::INVALID_ID, num_buffer_pixels_);
+	visibility_renderer_->Reset();
+}
+
+void GraphicDevice::ResolveVisibility()
+{
+	SR_ASSERT(in_frame_);
+
+	FrameBuffer frame_buffer = MakeFrameBuffer();
+	frame_buffer.visibility_buffer = visibility_buffer_;
+	visibility_renderer_->Resolve(frame_buffer);
+}
+
+void GraphicDevice::SetDepthOnly(bool enable)
+{
+	depth_only_ = enable;
+}
+
+bool GraphicDevice::IsDepthOnly() const
+{
+	return depth_only_;
+}
+
+void GraphicDevice::CullLights(const PointLight* lights, int32_t num_lights, const math::Matrix4x4& view_matrix, const math::Matrix4x4& projection_matrix)
+{
+	SR_ASSERT(in_frame_);
+	light_culler_->Cull(lights, num_lights, MakeFrameBuffer(), view_matrix, projection_matrix);
+}
+
+const LightGrid* GraphicDevice::GetLightGrid() const
+{
+	return &light_culler_->GetLightGrid();
+}
+
+void GraphicDevice::SetRasterizeFunction(rasterizer::RasterizeFunction rasterize_function)
+{
+	SR_ASSERT(rasterize_function);
+	rasterize_function_ = rasterize_function;
+}
+
+void GraphicDevice::DrawArrays(const VertexBuffer* vertex_buffer, int32_t first_vertex, int32_t num_vertices)
+{
+	SR_ASSERT(vertex_buffer);
+	SR_ASSERT(first_vertex >= 0 && first_vertex + num_vertices <= vertex_buffer->num_vertices);
+	SR_ASSERT(num_vertices % 3 == 0);
+	SR_ASSERT(in_frame_);
+
+	if (num_vertices == 0)
+	{
+		return;
+	}
+
+	ShadeVertices(vertex_buffer, nullptr, first_vertex, num_vertices);
+	DrawTriangles(nullptr, num_vertices / 3);
+}
+
+void GraphicDevice::DrawIndexed(const VertexBuffer* vertex_buffer, const IndexBuffer* index_buffer, int32_t first_index, int32_t num_indices)
+{
+	SR_ASSERT(vertex_buffer && index_buffer);
+	SR_ASSERT(first_index >= 0 && first_index + num_indices <= index_buffer->num_indices);
+	SR_ASSERT(num_indices % 3 == 0);
+	SR_ASSERT(in_frame_);
+
+	if (num_indices == 0)
+	{
+		return;
+	}
+
+	const uint32_t* indices = index_buffer->indices + first_index;
+	uint32_t min_index = indices[0];
+	uint32_t max_index = indices[0];
+	for (int32_t i = 1; i < num_indices; ++i)
+	{
+		min_index = std::min(min_index, indices[i]);
+		max_index = std::max(max_index, indices[i]);
+	}
+	SR_ASSERT(max_index < static_cast<uint32_t>(vertex_buffer->num_vertices));
+
+	// The cache covers the whole draw, so every referenced vertex is shaded exactly once
+	const int32_t num_slots = static_cast<int32_t>(max_index - min_index + 1);
+	int32_t* vertex_cache_slots = frame_arena_->AllocateArray<int32_t>(JobSystem::CALLING_THREAD_INDEX, num_slots);
+	uint32_t* vertex_cache_indices = frame_arena_->AllocateArray<uint32_t>(JobSystem::CALLING_THREAD_INDEX, math::Min(num_slots, num_indices));
+	uint32_t* triangle_cache_slots = frame_arena_->AllocateArray<uint32_t>(JobSystem::CALLING_THREAD_INDEX, num_indices);
+	std::fill_n(vertex_cache_slots, num_slots, -1);
+
+	int32_t num_cached_vertices = 0;
+	for (int32_t i = 0; i < num_indices; ++i)
+	{
+		int32_t& slot = vertex_cache_slots[indices[i] - min_index];
+		if (slot < 0)
+		{
+			slot = num_cached_vertices++;
+			vertex_cache_indices[slot] = indices[i];
+		}
+		triangle_cache_slots[i] = static_cast<uint32_t>(slot);
+	}
+
+	stats_.num_vertex_lookups += num_indices;
+	stats_.num_vertex_cache_hits += num_indices - num_cached_vertices;
+
+	ShadeVertices(vertex_buffer, vertex_cache_indices, 0, num_cached_vertices);
+	DrawTriangles(triangle_cache_slots, num_indices / 3);
+}
+
+const RenderStats& GraphicDevice::GetStats() const
+{
+	return stats_;
+}
+
+void GraphicDevice::ResetStats()
+{
+	stats_ = RenderStats();
+}
+
+FrameBuffer GraphicDevice::MakeFrameBuffer() const
 {
 	FrameBuffer frame_buffer;
 	frame_buffer.width = width_;
 	frame_buffer.height = height_;
 	frame_buffer.pixel_buffer = pixel_buffer_;
+	frame_buffer.color_format = color_format_;
 	frame_buffer.depth_buffer = depth_buffer_;
+	frame_buffer.depth_format = depth_format_;
+	frame_buffer.hiz_buffer = hiz_buffer_;
+	frame_buffer.hiz_dirty = hiz_dirty_;
+	frame_buffer.tiled = tiled_frame_buffer_;
+	frame_buffer.clear_state = clear_state_;
+	frame_buffer.clear_color = clear_color_;
+	frame_buffer.clear_depth = clear_depth_;
+	frame_buffer.normal_buffer = nullptr;
+	frame_buffer.visibility_buffer = nullptr;
+	return frame_buffer;
+}
 
-	FlatVertexData in_varyings[3]
+void GraphicDevice::ShadeVertices(const VertexBuffer* vertex_buffer, const uint32_t* vertex_indices, int32_t first_vertex, int32_t num_vertices)
+{
+	SR_ASSERT(shader_);
+	SR_ASSERT(vertex_buffer->sizeof_vertex == pipeline_context_->sizeof_attributes);
+
+	// Earlier draws of the frame keep their output, the visibility pass shades from it at the end of the frame
+	const int32_t sizeof_varyings = pipeline_context_->sizeof_varyings;
+	vertex_clip_coords_ = frame_arena_->AllocateArray<math::Vector4>(JobSystem::CALLING_THREAD_INDEX, num_vertices);
+	vertex_varyings_ = frame_arena_->AllocateArray<uint8_t>(JobSystem::CALLING_THREAD_INDEX, num_vertices * sizeof_varyings);
+	num_shaded_vertices_ = num_vertices;
+
+	// Each job runs the vertex stage over a contiguous batch of vertices
+	const int32_t num_batches = (num_vertices + VERTEX_BATCH_SIZE - 1) / VERTEX_BATCH_SIZE;
+	job_system_->ParallelFor(num_batches, [this, vertex_buffer, vertex_indices, first_vertex, num_vertices, sizeof_varyings](int32_t batch_index, int32_t thread_index)
 	{
-		{ math::Vector4(-0.0f, +0.5f, 1.0f, 1.0f), math::Vector4(1.0f, 0.0f, 0.0f, 1.0f) },
-		{ math::Vector4(-0.5f, -0.5f, 1.0f, 1.0f), math::Vector4(0.0f, 1.0f, 0.0f, 1.0f) },
-		{ math::Vector4(+0.5f, -0.5f, 1.0f, 1.0f), math::Vector4(0.0f, 0.0f, 1.0f, 1.0f) }
-	};
+		const int32_t begin = batch_index * VERTEX_BATCH_SIZE;
+		const int32_t end = math::Min(begin + VERTEX_BATCH_SIZE, num_vertices);
+		uint8_t* varyings = vertex_varyings_ + begin * sizeof_varyings;
+		for (int32_t i = begin; i < end; ++i)
+		{
+			const int32_t vertex_index = vertex_indices ? static_cast<int32_t>(vertex_indices[i]) : first_vertex + i;
+			const uint8_t* attributes = vertex_buffer->vertices + vertex_index * vertex_buffer->sizeof_vertex;
+			vertex_clip_coords_[i] = shader_->VertexShader(varyings, attributes, pipeline_context_->shader_constants);
+			varyings += sizeof_varyings;
+		}
+	});
+}
 
-	math::Vector4 vertices[3] = { in_varyings[0].position, in_varyings[1].position, in_varyings[2].position };
+void GraphicDevice::DrawTriangles(const uint32_t* cache_slots, int32_t num_triangles)
+{
+	FrameBuffer frame_buffer = MakeFrameBuffer();
+	pipeline_context_->shader = shader_;
+
+	// The geometry pass of deferred shaders writes albedo and normals instead of lit colors
+	if (shader_->IsDeferred() && !depth_only_)
+	{
+		// Pending color clears are filled first, the geometry pass would fill the albedo instead and drop them
+		framebuffer::FlushClears(frame_buffer, TILE_CLEAR_COLOR);
+		frame_buffer.pixel_buffer = gbuffer_albedo_;
+		frame_buffer.color_format = COLOR_FORMAT::RGBA8_UNORM;
+		frame_buffer.normal_buffer = gbuffer_normal_;
+	}
 
-	void* varyings[3];
-	varyings[0] = &in_varyings[0];
-	varyings[1] = &in_varyings[1];
-	varyings[2] = &in_varyings[2];
+	// Assemble triangles from the shaded vertices, without cache slots the vertices are consecutive
+	const int32_t sizeof_varyings = pipeline_context_->sizeof_varyings;
+	math::Vector4* triangle_clip_coords = frame_arena_->AllocateArray<math::Vector4>(JobSystem::CALLING_THREAD_INDEX, num_triangles * 3);
+	void** triangle_varyings = frame_arena_->AllocateArray<void*>(JobSystem::CALLING_THREAD_INDEX, num_triangles * 3);
+	for (int32_t i = 0; i < num_triangles * 3; ++i)
+	{
+		const uint32_t vertex_index = cache_slots ? cache_slots[i] : static_cast<uint32_t>(i);
+		triangle_clip_coords[i] = vertex_clip_coords_[vertex_index];
+		triangle_varyings[i] = vertex_varyings_ + vertex_index * sizeof_varyings;
+	}
 
-	pipeline_context_->shader = shader_;
-	rasterizer::RasterizeTriangle_V1(frame_buffer, *pipeline_context_, vertices, varyings);
+	// Cull the whole batch before any triangle reaches clipping and setup
+	int32_t* visible_triangles = frame_arena_->AllocateArray<int32_t>(JobSystem::CALLING_THREAD_INDEX, num_triangles);
+	const int32_t num_visible = rasterizer::CullTriangles(visible_triangles, *pipeline_context_, triangle_clip_coords, num_triangles);
+
+	// Resolve the state of this draw to a specialized kernel once, instead of per pixel
+	rasterizer::RasterizeFunction rasterize_function = rasterizer::SelectRasterizeFunction(rasterize_function_, *pipeline_context_);
+
+	// The visibility pass keeps the vertex stage output for the resolve and only rasterizes ids
+	int32_t draw_id = -1;
+	const bool visibility_pass = visibility_rendering_ && !depth_only_;
+	if (depth_only_)
+	{
+		// Discarded pixels would need the pixel shader to know which depths to keep
+		SR_ASSERT(!shader_->CanDiscard());
+		rasterize_function = rasterizer::RasterizeDepth;
+	}
+	else if (visibility_pass)
+	{
+		draw_id = visibility_renderer_->AddDraw(frame_buffer, *pipeline_context_, vertex_clip_coords_, vertex_varyings_, cache_slots, num_triangles);
+		frame_buffer.visibility_buffer = visibility_buffer_;
+		rasterize_function = rasterizer::RasterizeVisibility;
+	}
+
+	if (tiled_rendering_)
+	{
+		tile_renderer_->Begin(frame_buffer, *pipeline_context_, rasterize_function);
+		for (int32_t i = 0; i < num_visible; ++i)
+		{
+			const int32_t offset = visible_triangles[i] * 3;
+			if (visibility_pass)
+			{
+				pipeline_context_->primitive_id = VisibilityRenderer::MakeId(draw_id, visible_triangles[i]);
+			}
+			tile_renderer_->Submit(triangle_clip_coords + offset, triangle_varyings + offset);
+		}
+		tile_renderer_->End();
+	}
+	else
+	{
+		for (int32_t i = 0; i < num_visible; ++i)
+		{
+			const int32_t offset = visible_triangles[i] * 3;
+			if (visibility_pass)
+			{
+				pipeline_context_->primitive_id = VisibilityRenderer::MakeId(draw_id, visible_triangles[i]);
+			}
+			rasterizer::DrawTriangle(frame_buffer, *pipeline_context_, triangle_clip_coords + offset, triangle_varyings + offset, rasterize_function);
+		}
+	}
+}
+
+void GraphicDevice::LightTile(int32_t tile_x, int32_t tile_y)
+{
+	const int32_t min_x = tile_x * TileRenderer::TILE_SIZE;
+	const int32_t min_y = tile_y * TileRenderer::TILE_SIZE;
+	const int32_t max_x = math::Min(min_x + TileRenderer::TILE_SIZE, width_);
+	const int32_t max_y = math::Min(min_y + TileRenderer::TILE_SIZE, height_);
+
+	// Covered pixels are gathered into batches with the G-buffer unpacked per component
+	alignas(32) float positions[PIXEL_BATCH_SIZE * 3];
+	alignas(32) float normals[PIXEL_BATCH_SIZE * 3];
+	alignas(32) float albedo[PIXEL_BATCH_SIZE * 4];
+	alignas(16) math::Vector4 colors[PIXEL_BATCH_SIZE];
+	int32_t indices[PIXEL_BATCH_SIZE];
+	int32_t count = 0;
+
+	const FrameBuffer frame_buffer = MakeFrameBuffer();
+	const int32_t num_frame_tiles_x = (width_ + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE;
+	const float inv_width = 1.0f / static_cast<float>(width_);
+	const float inv_height = 1.0f / static_cast<float>(height_);
+	const auto flush = [&]()
+	{
+		shader_->LightPixels(count, positions, normals, albedo, pipeline_context_->shader_constants, colors);
+		framebuffer::StoreColors(frame_buffer, indices, count, colors);
+		count = 0;
+	};
+
+	// Frame buffer tiles with a pending normal clear were not covered by the geometry pass
+	for (int32_t block_y = min_y; block_y < max_y; block_y += FRAME_TILE_SIZE)
+	{
+		for (int32_t block_x = min_x; block_x < max_x; block_x += FRAME_TILE_SIZE)
+		{
+			if (clear_state_[(block_y / FRAME_TILE_SIZE) * num_frame_tiles_x + block_x / FRAME_TILE_SIZE] & TILE_CLEAR_NORMAL)
+			{
+				continue;
+			}
+
+			const int32_t block_max_x = math::Min(block_x + FRAME_TILE_SIZE, max_x);
+			const int32_t block_max_y = math::Min(block_y + FRAME_TILE_SIZE, max_y);
+			for (int32_t y = block_y; y < block_max_y; ++y)
+			{
+				for (int32_t x = block_x; x < block_max_x; ++x)
+				{
+					const int32_t index = framebuffer::PixelOffset(frame_buffer, x, y);
+					const uint32_t packed_normal = gbuffer_normal_[index];
+					if (packed_normal == 0)
+					{
+						continue;
+					}
+
+					// Inverse of the viewport transform of the rasterizer at the pixel center, depth is stored as NDC z
+					positions[count] = (static_cast<float>(x) + 0.5f) * inv_width * 2.0f - 1.0f;
+					positions[PIXEL_BATCH_SIZE + count] = 1.0f - (static_cast<float>(y) + 0.5f) * inv_height * 2.0f;
+					positions[PIXEL_BATCH_SIZE * 2 + count] = framebuffer::LoadDepth(frame_buffer, index);
+
+					const math::Vector3 normal = framebuffer::UnpackNormal(packed_normal);
+					normals[count] = normal.x;
+					normals[PIXEL_BATCH_SIZE + count] = normal.y;
+					normals[PIXEL_BATCH_SIZE * 2 + count] = normal.z;
+
+					for (int32_t c = 0; c < 4; ++c)
+					{
+						albedo[PIXEL_BATCH_SIZE * c + count] = math::FloatFromUChar(gbuffer_albedo_[index * 4 + c]);
+					}
+
+					indices[count++] = index;
+					if (count == PIXEL_BATCH_SIZE)
+					{
+						flush();
+					}
+				}
+			}
+		}
+	}
+
+	if (count > 0)
+	{
+		flush();
+	}
 }
@@ -2,8 +2,17 @@
 
 #include "core/sr_core_types.h"
 #include "core/sr_math.h"
+#include "core/sr_rasterizer.h"
 
 enum class SHADER_MODE : uint8_t;
+struct LightGrid;
+struct PointLight;
+struct FrameArenaStats;
+class FrameArena;
+class JobSystem;
+class LightCuller;
+class TileRenderer;
+class VisibilityRenderer;
 
 class GraphicDevice
 {
@@ -14,38 +23,193 @@ public:
 	void Initialize();
 	void Finalize();
 
+	// Releases the transient data of the previous frame, vertex stage output and everything derived from it
+	// lives in a frame arena until then, draws recorded for the visibility buffer are dropped with it
+	void BeginFrame();
+	FrameArenaStats GetFrameArenaStats() const;
+
+	// Makes the frame presentable, fills the pending color clears and resolves tiled colors to row-major order,
+	// draws and the visibility resolve are only valid between BeginFrame and EndFrame
+	void EndFrame();
+
 	int32_t GetWidth() const;
 	int32_t GetHeight() const;
 
+	// Raw storage of the frame buffer, in the tiled layout while tiled frame buffers are enabled,
+	// tiles with a pending fast clear hold stale values until FlushClears
 	uint8_t* GetPixelBuffer() const;
-	float* GetDepthBuffer() const;
+	void* GetDepthBuffer() const;
+
+	// Row-major pixels in the color format for presenting or reading back, as resolved by the last EndFrame
+	const uint8_t* ResolvePixelBuffer() const;
+	void FlushClears();
+
+	// Tiled frame buffers keep every 8x8 block of color and depth in its own cache lines,
+	// the contents are undefined after switching until the buffers are cleared
+	void SetTiledFrameBuffer(bool enable);
+	bool IsTiledFrameBuffer() const;
+
+	// Render target format written by output merge and clears, output merge writes alpha like the color channels,
+	// storage is sized for the widest format, the contents are undefined after switching until the pixel buffer is cleared
+	void SetColorFormat(COLOR_FORMAT color_format);
+	COLOR_FORMAT GetColorFormat() const;
+
+	// Depth storage is sized for 32 bits per pixel, so every format fits without reallocating,
+	// the contents are undefined after switching until the depth buffer is cleared
+	void SetDepthFormat(DEPTH_FORMAT depth_format);
+	DEPTH_FORMAT GetDepthFormat() const;
 
+	// Fast clears, only the tiles are marked and the first block touching a tile fills it,
+	// tiles a triangle overwrites completely are never filled
 	void ClearPixelBuffer(const math::Vector4& clear_color);
 	void ClearDepthBuffer(float clear_depth);
 
-	PipelineContext* CreatePipelineContext(int32_t sizeof_attributes, int32_t sizeof_varyings, int32_t sizeof_constants, bool two_sided, bool enable_blend);
-	void ReleasePipelineContext(PipelineContext* context);
+	// Deferred shading, draws with a deferred shader fill the G-buffer and LightGBuffer lights
+	// every covered pixel once into the pixel buffer, in parallel over screen tiles
+	void ClearGBuffer();
+	void LightGBuffer();
+
+	VertexBuffer* CreateVertexBuffer(const void* vertices, int32_t sizeof_vertex, int32_t num_vertices);
+	void ReleaseVertexBuffer(VertexBuffer* vertex_buffer);
+
+	IndexBuffer* CreateIndexBuffer(const uint32_t* indices, int32_t num_indices);
+	void ReleaseIndexBuffer(IndexBuffer* index_buffer);
+
+	Texture2D* CreateTexture2D(const char* filename);
+	Texture2D* CreateTexture2D(const uint8_t* pixels, int32_t width, int32_t height);
+	void ReleaseTexture2D(Texture2D* texture);
 
 	IShader* SelectShader(SHADER_MODE mode);
 	void DeleteShader();
 	IShader* GetShader() const;
-
-	void Draw();
+	void SetShaderConstants(const void* constants);
+
+	// Culling of the following draws, kept when SelectShader switches shaders, front_face also decides which side
+	// the pixel stage sees as front facing, two-sided draws are never culled and lit shaders negate the normal of back faces
+	void SetCullMode(CULL_MODE cull_mode);
+	CULL_MODE GetCullMode() const;
+	void SetFrontFace(FRONT_FACE front_face);
+	FRONT_FACE GetFrontFace() const;
+	void SetTwoSided(bool enable);
+	bool IsTwoSided() const;
+
+	// Depth and blend state of the following draws, kept when SelectShader switches shaders,
+	// depth writes only happen while the depth test is enabled, blending mixes the pixel shader color over the target by its alpha
+	void SetDepthTest(bool enable);
+	bool IsDepthTest() const;
+	void SetDepthWrite(bool enable);
+	bool IsDepthWrite() const;
+	void SetDepthFunc(DEPTH_FUNC depth_func);
+	DEPTH_FUNC GetDepthFunc() const;
+	void SetBlend(bool enable);
+	bool IsBlend() const;
+
+	void SetTiledRendering(bool enable);
+	bool IsTiledRendering() const;
+
+	// Visibility buffer rendering, draws only rasterize depth and primitive ids until ResolveVisibility
+	// runs the pixel shader once per visible pixel, ClearVisibilityBuffer starts a new frame
+	void SetVisibilityRendering(bool enable);
+	bool IsVisibilityRendering() const;
+	void ClearVisibilityBuffer();
+	void ResolveVisibility();
+
+	// Depth-only draws run the depth test and depth writes without the pixel shader or any color write,
+	// the shader must not discard, visibility rendering records no depth-only draw
+	void SetDepthOnly(bool enable);
+	bool IsDepthOnly() const;
+
+	// Forward+, culls the lights against the depth of a depth pre-pass already in the depth buffer,
+	// drawn depth-only, the grid lives in the frame arena and stays valid until the next call or BeginFrame,
+	// it is handed to the shader through its constants
+	void CullLights(const PointLight* lights, int32_t num_lights, const math::Matrix4x4& view_matrix, const math::Matrix4x4& projection_matrix);
+	const LightGrid* GetLightGrid() const;
+
+	void SetRasterizeFunction(rasterizer::RasterizeFunction rasterize_function);
+
+	void DrawArrays(const VertexBuffer* vertex_buffer, int32_t first_vertex, int32_t num_vertices);
+	void DrawIndexed(const VertexBuffer* vertex_buffer, const IndexBuffer* index_buffer, int32_t first_index, int32_t num_indices);
+
+	const RenderStats& GetStats() const;
+	void ResetStats();
 
 private:
+	static constexpr int32_t VERTEX_BATCH_SIZE = 256;
+
+	// Sized for the attributes, varyings and constants of a shader, with the current render state
+	PipelineContext* CreatePipelineContext(int32_t sizeof_attributes, int32_t sizeof_varyings, int32_t sizeof_constants);
+	void ReleasePipelineContext(PipelineContext* context);
+
+	FrameBuffer MakeFrameBuffer() const;
+	void MarkClear(uint8_t planes);
+	void ShadeVertices(const VertexBuffer* vertex_buffer, const uint32_t* vertex_indices, int32_t first_vertex, int32_t num_vertices);
+	void DrawTriangles(const uint32_t* cache_slots, int32_t num_triangles);
+	void LightTile(int32_t tile_x, int32_t tile_y);
+
 	template<typename BufferType>
 	void CopyBuffer(BufferType* dst, BufferType src, int32_t count) const;
 
 private:
 	uint8_t* pixel_buffer_;
-	float* depth_buffer_;
+	COLOR_FORMAT color_format_;
+	void* depth_buffer_;
+	DEPTH_FORMAT depth_format_;
+	uint8_t* resolve_buffer_;
+	int32_t num_buffer_pixels_;
+	bool tiled_frame_buffer_;
+	float* hiz_buffer_;
+	uint8_t* hiz_dirty_;
+
+	// Pending fast clears per frame buffer tile
+	uint8_t* clear_state_;
+	uint64_t clear_color_;
+	float clear_depth_;
+
+	// G-buffer of the deferred geometry pass, RGBA8 albedo and octahedral normals, 0 where no pixel was covered,
+	// ClearGBuffer is a fast clear of the normals like the clears of the frame buffer
+	uint8_t* gbuffer_albedo_;
+	uint32_t* gbuffer_normal_;
+
+	uint32_t* visibility_buffer_;
 
 	int32_t width_;
 	int32_t height_;
+	int32_t num_hiz_tiles_;
 
 	IShader* shader_;
 
 	PipelineContext* pipeline_context_;
+	CULL_MODE cull_mode_;
+	FRONT_FACE front_face_;
+	bool two_sided_;
+	bool depth_test_;
+	bool depth_write_;
+	DEPTH_FUNC depth_func_;
+	bool enable_blend_;
+
+	JobSystem* job_system_;
+	TileRenderer* tile_renderer_;
+	bool tiled_rendering_;
+
+	VisibilityRenderer* visibility_renderer_;
+	bool visibility_rendering_;
+
+	LightCuller* light_culler_;
+	bool depth_only_;
+
+	rasterizer::RasterizeFunction rasterize_function_;
+
+	// Transient pipeline data, reset by BeginFrame
+	FrameArena* frame_arena_;
+	// Between BeginFrame and EndFrame, draws outside a frame would grow the arena without bound
+	bool in_frame_;
+
+	// Vertex stage output of the current draw, allocated from the frame arena
+	math::Vector4* vertex_clip_coords_;
+	uint8_t* vertex_varyings_;
+	int32_t num_shaded_vertices_;
+
+	RenderStats stats_;
 };
 
 template<typename BufferType>
@@ -0,0 +1,118 @@
+#include "sr_pch.h"
+#include "core/sr_job_system.h"
+
+JobSystem::JobSystem(int32_t num_threads)
+	: job_(nullptr)
+	, job_count_(0)
+	, next_job_index_(0)
+	, generation_(0)
+	, num_busy_workers_(0)
+	, quit_(false)
+{
+	SR_ASSERT(num_threads > 0);
+
+	// The calling thread always takes part in ParallelFor, so spawn one thread less
+	for (int32_t i = 1; i < num_threads; ++i)
+	{
+		workers_.emplace_back(&JobSystem::WorkerMain, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		quit_ = true;
+	}
+	start_condition_.notify_all();
+
+	for (std::thread& worker : workers_)
+	{
+		worker.join();
+	}
+}
+
+int32_t JobSystem::GetNumThreads() const
+{
+	return static_cast<int32_t>(workers_.size()) + 1;
+}
+
+void JobSystem::ParallelFor(int32_t count, const Job& job)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	if (workers_.empty() || count == 1)
+	{
+		for (int32_t i = 0; i < count; ++i)
+		{
+			job(i, 0);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		job_ = &job;
+		job_count_ = count;
+		next_job_index_.store(0, std::memory_order_relaxed);
+		num_busy_workers_ = static_cast<int32_t>(workers_.size());
+		++generation_;
+	}
+	start_condition_.notify_all();
+
+	RunJobs(CALLING_THREAD_INDEX);
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	finish_condition_.wait(lock, [this]() { return num_busy_workers_ == 0; });
+	job_ = nullptr;
+}
+
+void JobSystem::WorkerMain(int32_t thread_index)
+{
+	uint32_t last_generation = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			start_condition_.wait(lock, [this, last_generation]() { return quit_ || generation_ != last_generation; });
+
+			if (quit_)
+			{
+				return;
+			}
+
+			last_generation = generation_;
+		}
+
+		RunJobs(thread_index);
+
+		bool finished = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			finished = --num_busy_workers_ == 0;
+		}
+
+		if (finished)
+		{
+			finish_condition_.notify_one();
+		}
+	}
+}
+
+void JobSystem::RunJobs(int32_t thread_index)
+{
+	while (true)
+	{
+		const int32_t index = next_job_index_.fetch_add(1, std::memory_order_relaxed);
+		if (index >= job_count_)
+		{
+			break;
+		}
+
+		(*job_)(index, thread_index);
+	}
+}
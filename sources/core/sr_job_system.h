@@ -0,0 +1,38 @@
+#pragma once
+
+class JobSystem
+{
+public:
+	using Job = std::function<void(int32_t index, int32_t thread_index)>;
+
+	// Thread index of the thread calling ParallelFor, workers are numbered from 1
+	static constexpr int32_t CALLING_THREAD_INDEX = 0;
+
+	explicit JobSystem(int32_t num_threads);
+	~JobSystem();
+
+	// Number of threads that execute jobs, including the calling thread
+	int32_t GetNumThreads() const;
+
+	// Runs job(index, thread_index) for every index in [0, count) and returns once all of them are done
+	void ParallelFor(int32_t count, const Job& job);
+
+private:
+	void WorkerMain(int32_t thread_index);
+	void RunJobs(int32_t thread_index);
+
+private:
+	std::vector<std::thread> workers_;
+
+	std::mutex mutex_;
+	std::condition_variable start_condition_;
+	std::condition_variable finish_condition_;
+
+	const Job* job_;
+	int32_t job_count_;
+	std::atomic<int32_t> next_job_index_;
+
+	uint32_t generation_;
+	int32_t num_busy_workers_;
+	bool quit_;
+};
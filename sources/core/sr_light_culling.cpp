@@ -0,0 +1,159 @@
+#include "sr_pch.h"
+#include "core/sr_light_culling.h"
+#include "core/sr_frame_buffer.h"
+#include "core/sr_job_system.h"
+
+LightCuller::LightCuller(JobSystem* job_system, FrameArena* frame_arena, int32_t width, int32_t height)
+	: job_system_(job_system)
+	, frame_arena_(frame_arena)
+	, width_(width)
+	, height_(height)
+	, num_tiles_x_((width + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE)
+	, num_tiles_y_((height + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE)
+	, view_lights_(nullptr)
+	, num_view_lights_(0)
+	, light_grid_()
+{
+	SR_ASSERT(job_system_ && frame_arena_);
+
+	tile_lights_.resize(num_tiles_x_ * num_tiles_y_);
+	tile_offsets_.assign(num_tiles_x_ * num_tiles_y_ + 1, 0);
+
+	light_grid_.num_tiles_x = num_tiles_x_;
+	light_grid_.num_tiles_y = num_tiles_y_;
+	light_grid_.tile_offsets = tile_offsets_.data();
+}
+
+void LightCuller::Cull(const PointLight* lights, int32_t num_lights, const FrameBuffer& frame_buffer, const math::Matrix4x4& view_matrix, const math::Matrix4x4& projection_matrix)
+{
+	SR_ASSERT(lights || num_lights == 0);
+	SR_ASSERT(frame_buffer.width == width_ && frame_buffer.height == height_);
+
+	math::Vector4* view_lights = frame_arena_->AllocateArray<math::Vector4>(JobSystem::CALLING_THREAD_INDEX, num_lights);
+	for (int32_t i = 0; i < num_lights; ++i)
+	{
+		const PointLight& light = lights[i];
+		const math::Vector4 center = math::Vector4(light.position.x, light.position.y, light.position.z, 1.0f) * view_matrix;
+		view_lights[i] = math::Vector4(center.x, center.y, center.z, light.radius);
+	}
+	view_lights_ = view_lights;
+	num_view_lights_ = num_lights;
+
+	const math::Matrix4x4 inverse_projection = math::MatrixInverse(projection_matrix);
+	job_system_->ParallelFor(num_tiles_x_ * num_tiles_y_, [this, &frame_buffer, &inverse_projection](int32_t tile_index, int32_t thread_index)
+	{
+		CullTile(tile_index, thread_index, frame_buffer, inverse_projection);
+	});
+
+	// Flatten the tile lists, shaders walk one contiguous range per tile
+	const int32_t num_tiles = num_tiles_x_ * num_tiles_y_;
+	uint32_t offset = 0;
+	for (int32_t i = 0; i < num_tiles; ++i)
+	{
+		tile_offsets_[i] = offset;
+		offset += static_cast<uint32_t>(tile_lights_[i].GetSize());
+	}
+	tile_offsets_[num_tiles] = offset;
+
+	uint32_t* light_indices = frame_arena_->AllocateArray<uint32_t>(JobSystem::CALLING_THREAD_INDEX, offset);
+	for (int32_t i = 0; i < num_tiles; ++i)
+	{
+		tile_lights_[i].CopyTo(light_indices + tile_offsets_[i]);
+	}
+
+	light_grid_.lights = lights;
+	light_grid_.light_indices = light_indices;
+}
+
+const LightGrid& LightCuller::GetLightGrid() const
+{
+	return light_grid_;
+}
+
+void LightCuller::CullTile(int32_t tile_index, int32_t thread_index, const FrameBuffer& frame_buffer, const math::Matrix4x4& inverse_projection)
+{
+	const int32_t min_x = (tile_index % num_tiles_x_) * LIGHT_TILE_SIZE;
+	const int32_t min_y = (tile_index / num_tiles_x_) * LIGHT_TILE_SIZE;
+	const int32_t max_x = math::Min(min_x + LIGHT_TILE_SIZE, width_);
+	const int32_t max_y = math::Min(min_y + LIGHT_TILE_SIZE, height_);
+
+	FrameList<uint32_t>& tile_lights = tile_lights_[tile_index];
+	tile_lights.Clear();
+
+	// Depth range of the geometry in the tile, depth is stored as NDC z
+	// Pixels still at the clear depth are background, no surface there is lit, so they would only
+	// stretch the range of silhouette tiles out to the far plane
+	const float background_depth = framebuffer::QuantizeDepth(frame_buffer, frame_buffer.clear_depth);
+	float min_depth = 1.0f;
+	float max_depth = -1.0f;
+	const int32_t num_frame_tiles_x = (frame_buffer.width + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE;
+	for (int32_t block_y = min_y; block_y < max_y; block_y += FRAME_TILE_SIZE)
+	{
+		for (int32_t block_x = min_x; block_x < max_x; block_x += FRAME_TILE_SIZE)
+		{
+			// Frame buffer tiles with a pending depth clear were never written
+			const int32_t frame_tile_index = (block_y / FRAME_TILE_SIZE) * num_frame_tiles_x + block_x / FRAME_TILE_SIZE;
+			if (frame_buffer.clear_state && (frame_buffer.clear_state[frame_tile_index] & TILE_CLEAR_DEPTH))
+			{
+				continue;
+			}
+
+			const int32_t block_max_x = math::Min(block_x + FRAME_TILE_SIZE, max_x);
+			const int32_t block_max_y = math::Min(block_y + FRAME_TILE_SIZE, max_y);
+			for (int32_t y = block_y; y < block_max_y; ++y)
+			{
+				const int32_t row_offset = framebuffer::RowOffset(frame_buffer, block_x, y);
+				for (int32_t x = block_x; x < block_max_x; ++x)
+				{
+					const float depth = framebuffer::LoadDepth(frame_buffer, row_offset + x);
+					if (depth == background_depth)
+					{
+						continue;
+					}
+
+					min_depth = math::Min(min_depth, depth);
+					max_depth = math::Max(max_depth, depth);
+				}
+			}
+		}
+	}
+
+	// Background only, no light touches anything in the tile
+	if (min_depth > max_depth)
+	{
+		return;
+	}
+
+	// View-space box around the eight corners of the tile frustum between both depths
+	const float ndc_x[2] = { static_cast<float>(min_x) / static_cast<float>(width_) * 2.0f - 1.0f, static_cast<float>(max_x) / static_cast<float>(width_) * 2.0f - 1.0f };
+	const float ndc_y[2] = { 1.0f - static_cast<float>(max_y) / static_cast<float>(height_) * 2.0f, 1.0f - static_cast<float>(min_y) / static_cast<float>(height_) * 2.0f };
+	const float ndc_z[2] = { min_depth, max_depth };
+
+	const auto corner_point = [&](int32_t corner)
+	{
+		const math::Vector4 view = math::Vector4(ndc_x[corner & 1], ndc_y[(corner >> 1) & 1], ndc_z[corner >> 2], 1.0f) * inverse_projection;
+		return math::Vector3(view.x, view.y, view.z) / view.w;
+	};
+
+	math::Vector3 box_min = corner_point(0);
+	math::Vector3 box_max = box_min;
+	for (int32_t corner = 1; corner < 8; ++corner)
+	{
+		const math::Vector3 point = corner_point(corner);
+		box_min = math::Vector3(math::Min(box_min.x, point.x), math::Min(box_min.y, point.y), math::Min(box_min.z, point.z));
+		box_max = math::Vector3(math::Max(box_max.x, point.x), math::Max(box_max.y, point.y), math::Max(box_max.z, point.z));
+	}
+
+	// Sphere against box, distance from the center to the nearest point of the box
+	for (int32_t i = 0; i < num_view_lights_; ++i)
+	{
+		const math::Vector4& light = view_lights_[i];
+		const float dx = light.x - math::Clamp(light.x, box_min.x, box_max.x);
+		const float dy = light.y - math::Clamp(light.y, box_min.y, box_max.y);
+		const float dz = light.z - math::Clamp(light.z, box_min.z, box_max.z);
+		if (dx * dx + dy * dy + dz * dz <= light.w * light.w)
+		{
+			tile_lights.Push(*frame_arena_, thread_index, static_cast<uint32_t>(i));
+		}
+	}
+}
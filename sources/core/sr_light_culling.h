@@ -0,0 +1,67 @@
+#pragma once
+
+#include "core/sr_core_types.h"
+#include "core/sr_frame_arena.h"
+#include "core/sr_math.h"
+
+class JobSystem;
+
+// Screen tiles of the light grid in pixels, a multiple of FRAME_TILE_SIZE
+constexpr int32_t LIGHT_TILE_SIZE = 16;
+
+struct PointLight
+{
+	math::Vector3 position;
+	float radius;
+	math::Vector3 color;
+	float intensity;
+};
+
+// The lights of tile t are lights[light_indices[i]] for i in [tile_offsets[t], tile_offsets[t + 1])
+struct LightGrid
+{
+	int32_t num_tiles_x;
+	int32_t num_tiles_y;
+	const PointLight* lights;
+	const uint32_t* tile_offsets;
+	const uint32_t* light_indices;
+};
+
+/*
+ * Tiled light culling of Forward+
+ * Every screen tile takes its depth range from the depth buffer of a depth pre-pass and keeps the
+ * lights whose sphere touches the view-space box around that slice of the tile frustum.
+ */
+class LightCuller
+{
+public:
+	LightCuller(JobSystem* job_system, FrameArena* frame_arena, int32_t width, int32_t height);
+
+	// The lights must stay alive for as long as the grid is used, the light lists of the grid are
+	// allocated from the frame arena and are invalid after it is reset
+	void Cull(const PointLight* lights, int32_t num_lights, const FrameBuffer& frame_buffer, const math::Matrix4x4& view_matrix, const math::Matrix4x4& projection_matrix);
+
+	const LightGrid& GetLightGrid() const;
+
+private:
+	void CullTile(int32_t tile_index, int32_t thread_index, const FrameBuffer& frame_buffer, const math::Matrix4x4& inverse_projection);
+
+private:
+	JobSystem* job_system_;
+	FrameArena* frame_arena_;
+
+	int32_t width_;
+	int32_t height_;
+	int32_t num_tiles_x_;
+	int32_t num_tiles_y_;
+
+	// View-space center in xyz and radius in w, allocated from the frame arena like the light lists
+	const math::Vector4* view_lights_;
+	int32_t num_view_lights_;
+
+	// Every tile fills its list from the sub-arena of the thread culling it, Cull flattens them into one array
+	std::vector<FrameList<uint32_t>> tile_lights_;
+	std::vector<uint32_t> tile_offsets_;
+
+	LightGrid light_grid_;
+};
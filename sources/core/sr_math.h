@@ -39,6 +39,7 @@ namespace math
 	/* General functions */
 	inline int32_t CeilToInt(float x);
 	inline int32_t FloorToInt(float x);
+	inline int32_t RoundToInt(float x);
 	inline int32_t Clamp(int32_t x, int32_t min, int32_t max);
 	inline float Clamp(float x, float min, float max);
 	inline int32_t Min(int32_t a, int32_t b);
@@ -53,6 +54,8 @@ namespace math
 	inline float FloatSaturate(float f);
 	inline float FloatFromUChar(uint8_t value);
 	inline uint8_t FloatToUChar(float value);
+	inline float FloatFromHalf(uint16_t value);
+	inline uint16_t FloatToHalf(float value);
 
 	/* Vector2 related functions */
 	inline const Vector2 operator+(const Vector2& v);
@@ -108,6 +111,7 @@ namespace math
 	/* Matrix4x4 related functions */
 	inline const Matrix4x4 operator*(const Matrix4x4& a, const Matrix4x4& b);
 	inline Matrix4x4& operator*=(Matrix4x4& a, const Matrix4x4& b);
+	inline const Matrix4x4 MatrixInverse(const Matrix4x4& m);
 	inline const Matrix4x4 MatrixLookAt(const Vector3& eye, const Vector3& target, const Vector3& up);
 	inline const Matrix4x4 MatrixPerspective(float fovy, float aspect, float near, float far);
 	inline const Matrix4x4 MatrixRotateX(float angle);
@@ -130,6 +134,11 @@ int32_t math::FloorToInt(float x)
 	return static_cast<int32_t>(floor(x));
 }
 
+int32_t math::RoundToInt(float x)
+{
+	return static_cast<int32_t>(floor(x + 0.5f));
+}
+
 int32_t math::Clamp(int32_t x, int32_t min, int32_t max)
 {
 	return x < min ? min : x > max ? max : x;
@@ -194,6 +203,59 @@ uint8_t math::FloatToUChar(float value)
 	return static_cast<uint8_t>(value * 255.0f);
 }
 
+float math::FloatFromHalf(uint16_t value)
+{
+	const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+	const uint32_t exponent = (value >> 10) & 0x1f;
+	const uint32_t mantissa = value & 0x3ff;
+	if (exponent == 0)
+	{
+		// Zero or denormal, mantissa * 2^-24 is exact in float
+		const float magnitude = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+		return sign ? -magnitude : magnitude;
+	}
+
+	const uint32_t bits = exponent == 0x1f ? sign | 0x7f800000 | (mantissa << 13) : sign | ((exponent + 112) << 23) | (mantissa << 13);
+	return std::bit_cast<float>(bits);
+}
+
+uint16_t math::FloatToHalf(float value)
+{
+	const uint32_t bits = std::bit_cast<uint32_t>(value);
+	const uint32_t sign = (bits >> 16) & 0x8000;
+	const uint32_t magnitude = bits & 0x7fffffff;
+
+	// Too large for half becomes infinity, NaN stays NaN
+	if (magnitude >= 0x47800000)
+	{
+		return static_cast<uint16_t>(sign | (magnitude > 0x7f800000 ? 0x7e00 : 0x7c00));
+	}
+
+	// Below the smallest normal half the value becomes a denormal, rounded to nearest even
+	if (magnitude < 0x38800000)
+	{
+		const uint32_t shift = 126 - (magnitude >> 23);
+		if (shift > 24)
+		{
+			return static_cast<uint16_t>(sign);
+		}
+
+		const uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+		const uint32_t half = 1u << (shift - 1);
+		const uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t result = mantissa >> shift;
+		if (remainder > half || (remainder == half && (result & 1)))
+		{
+			++result;
+		}
+		return static_cast<uint16_t>(sign | result);
+	}
+
+	// Rebias the exponent and round the mantissa to nearest even, a carry into the exponent is still correct
+	const uint32_t rounded = magnitude + 0xfff + ((magnitude >> 13) & 1);
+	return static_cast<uint16_t>(sign | ((rounded - 0x38000000) >> 13));
+}
+
 const math::Vector2 math::operator+(const Vector2& v)
 {
 	return Vector2(v.x, v.y);
@@ -471,6 +533,51 @@ math::Matrix4x4& math::operator*=(Matrix4x4& a, const Matrix4x4& b)
 	return a;
 }
 
+const math::Matrix4x4 math::MatrixInverse(const Matrix4x4& m)
+{
+	// Cofactor expansion over the 2x2 sub-determinants of the upper and lower row pairs
+	const float s0 = m.m[0][0] * m.m[1][1] - m.m[1][0] * m.m[0][1];
+	const float s1 = m.m[0][0] * m.m[1][2] - m.m[1][0] * m.m[0][2];
+	const float s2 = m.m[0][0] * m.m[1][3] - m.m[1][0] * m.m[0][3];
+	const float s3 = m.m[0][1] * m.m[1][2] - m.m[1][1] * m.m[0][2];
+	const float s4 = m.m[0][1] * m.m[1][3] - m.m[1][1] * m.m[0][3];
+	const float s5 = m.m[0][2] * m.m[1][3] - m.m[1][2] * m.m[0][3];
+
+	const float c5 = m.m[2][2] * m.m[3][3] - m.m[3][2] * m.m[2][3];
+	const float c4 = m.m[2][1] * m.m[3][3] - m.m[3][1] * m.m[2][3];
+	const float c3 = m.m[2][1] * m.m[3][2] - m.m[3][1] * m.m[2][2];
+	const float c2 = m.m[2][0] * m.m[3][3] - m.m[3][0] * m.m[2][3];
+	const float c1 = m.m[2][0] * m.m[3][2] - m.m[3][0] * m.m[2][2];
+	const float c0 = m.m[2][0] * m.m[3][1] - m.m[3][0] * m.m[2][1];
+
+	const float determinant = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+	SR_ASSERT(determinant != 0.0f);
+	const float inv_determinant = 1.0f / determinant;
+
+	Matrix4x4 result;
+	result.m[0][0] = (m.m[1][1] * c5 - m.m[1][2] * c4 + m.m[1][3] * c3) * inv_determinant;
+	result.m[0][1] = (-m.m[0][1] * c5 + m.m[0][2] * c4 - m.m[0][3] * c3) * inv_determinant;
+	result.m[0][2] = (m.m[3][1] * s5 - m.m[3][2] * s4 + m.m[3][3] * s3) * inv_determinant;
+	result.m[0][3] = (-m.m[2][1] * s5 + m.m[2][2] * s4 - m.m[2][3] * s3) * inv_determinant;
+
+	result.m[1][0] = (-m.m[1][0] * c5 + m.m[1][2] * c2 - m.m[1][3] * c1) * inv_determinant;
+	result.m[1][1] = (m.m[0][0] * c5 - m.m[0][2] * c2 + m.m[0][3] * c1) * inv_determinant;
+	result.m[1][2] = (-m.m[3][0] * s5 + m.m[3][2] * s2 - m.m[3][3] * s1) * inv_determinant;
+	result.m[1][3] = (m.m[2][0] * s5 - m.m[2][2] * s2 + m.m[2][3] * s1) * inv_determinant;
+
+	result.m[2][0] = (m.m[1][0] * c4 - m.m[1][1] * c2 + m.m[1][3] * c0) * inv_determinant;
+	result.m[2][1] = (-m.m[0][0] * c4 + m.m[0][1] * c2 - m.m[0][3] * c0) * inv_determinant;
+	result.m[2][2] = (m.m[3][0] * s4 - m.m[3][1] * s2 + m.m[3][3] * s0) * inv_determinant;
+	result.m[2][3] = (-m.m[2][0] * s4 + m.m[2][1] * s2 - m.m[2][3] * s0) * inv_determinant;
+
+	result.m[3][0] = (-m.m[1][0] * c3 + m.m[1][1] * c1 - m.m[1][2] * c0) * inv_determinant;
+	result.m[3][1] = (m.m[0][0] * c3 - m.m[0][1] * c1 + m.m[0][2] * c0) * inv_determinant;
+	result.m[3][2] = (-m.m[3][0] * s3 + m.m[3][1] * s1 - m.m[3][2] * s0) * inv_determinant;
+	result.m[3][3] = (m.m[2][0] * s3 - m.m[2][1] * s1 + m.m[2][2] * s0) * inv_determinant;
+
+	return result;
+}
+
 const math::Matrix4x4 math::MatrixLookAt(const Vector3& from, const Vector3& to, const Vector3& up)
 {
 	const Vector3 z_axis = Vector3Normalize(to - from);
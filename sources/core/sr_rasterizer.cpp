@@ -1,197 +1,14 @@
 #include "sr_pch.h"
 #include "core/sr_rasterizer.h"
+#include "core/sr_frame_buffer.h"
+#include "core/sr_rasterizer_kernels.h"
+#include "core/sr_simd.h"
 #include "shaders/sr_shader_interface.h"
 
-struct Edge
-{
-	math::Vector2 screen_coord1;
-	math::Vector2 screen_coord2;
-	float screen_depth1;
-	float screen_depth2;
-	void* varyings1;
-	void* varyings2;
-};
-
-struct Trapezoid
-{
-	float top;
-	float bottom;
-	Edge left;
-	Edge right;
-};
-
-static int32_t MakeTrapezoid_V1(Trapezoid trapezoid[2], const math::Vector2 screen_coords[3], const float screen_depth[3], void* varyings[3])
-{
-	int32_t top_index = 0;
-	int32_t middle_index = 1;
-	int32_t bottom_index = 2;
-
-	if (screen_coords[top_index].y > screen_coords[middle_index].y) { std::swap(top_index, middle_index); }
-	if (screen_coords[top_index].y > screen_coords[bottom_index].y) { std::swap(top_index, bottom_index); }
-	if (screen_coords[middle_index].y > screen_coords[bottom_index].y) { std::swap(middle_index, bottom_index); }
-	if (screen_coords[top_index].x == screen_coords[middle_index].x && screen_coords[middle_index].x == screen_coords[bottom_index].x) { return 0; }
-	if (screen_coords[top_index].y == screen_coords[middle_index].y && screen_coords[middle_index].y == screen_coords[bottom_index].y) { return 0; }
-
-	//    T
-	//  /   \
-	// M  -  B
-	if (screen_coords[top_index].y != screen_coords[middle_index].y && screen_coords[middle_index].y == screen_coords[bottom_index].y)
-	{
-		if (screen_coords[middle_index].x > screen_coords[bottom_index].x) { std::swap(middle_index, bottom_index); }
-
-		trapezoid[0].top = screen_coords[top_index].y;
-		trapezoid[0].bottom = screen_coords[bottom_index].y;
-		trapezoid[0].left.screen_coord1 = screen_coords[top_index];
-		trapezoid[0].left.screen_coord2 = screen_coords[middle_index];
-		trapezoid[0].left.screen_depth1 = screen_depth[top_index];
-		trapezoid[0].left.screen_depth2 = screen_depth[middle_index];
-		trapezoid[0].left.varyings1 = varyings[top_index];
-		trapezoid[0].left.varyings2 = varyings[middle_index];
-		trapezoid[0].right.screen_coord1 = screen_coords[top_index];
-		trapezoid[0].right.screen_coord2 = screen_coords[bottom_index];
-		trapezoid[0].right.screen_depth1 = screen_depth[top_index];
-		trapezoid[0].right.screen_depth2 = screen_depth[bottom_index];
-		trapezoid[0].right.varyings1 = varyings[top_index];
-		trapezoid[0].right.varyings2 = varyings[bottom_index];
-		return 1;
-	}
-
-	// T  -  M
-	//  \   /
-	//    B
-	if (screen_coords[top_index].y == screen_coords[middle_index].y && screen_coords[middle_index].y != screen_coords[bottom_index].y)
-	{
-		if (screen_coords[top_index].x > screen_coords[middle_index].x) { std::swap(top_index, middle_index); }
-
-		trapezoid[0].top = screen_coords[top_index].y;
-		trapezoid[0].bottom = screen_coords[bottom_index].y;
-		trapezoid[0].left.screen_coord1 = screen_coords[top_index];
-		trapezoid[0].left.screen_coord2 = screen_coords[bottom_index];
-		trapezoid[0].left.screen_depth1 = screen_depth[top_index];
-		trapezoid[0].left.screen_depth2 = screen_depth[bottom_index];
-		trapezoid[0].left.varyings1 = varyings[top_index];
-		trapezoid[0].left.varyings2 = varyings[bottom_index];
-		trapezoid[0].right.screen_coord1 = screen_coords[middle_index];
-		trapezoid[0].right.screen_coord2 = screen_coords[bottom_index];
-		trapezoid[0].right.screen_depth1 = screen_depth[middle_index];
-		trapezoid[0].right.screen_depth2 = screen_depth[bottom_index];
-		trapezoid[0].right.varyings1 = varyings[middle_index];
-		trapezoid[0].right.varyings2 = varyings[bottom_index];
-		return 1;
-	}
-
-	// T \      / T
-	// |  M or M  |
-	// B /      \ B
-	const float t = (screen_coords[middle_index].y - screen_coords[top_index].y) / (screen_coords[bottom_index].y - screen_coords[top_index].y);
-	const float x = screen_coords[middle_index].x + (screen_coords[bottom_index].x - screen_coords[middle_index].x) * t;
-
-	trapezoid[0].top = screen_coords[top_index].y;
-	trapezoid[0].bottom = screen_coords[middle_index].y;
-	trapezoid[1].top = screen_coords[middle_index].y;
-	trapezoid[1].bottom = screen_coords[bottom_index].y;
-
-	// T \ 
-	// |  M
-	// B / 
-	if (screen_coords[middle_index].x > x)
-	{
-		// Triangle top - middle
-		trapezoid[0].left.screen_coord1 = screen_coords[top_index];
-		trapezoid[0].left.screen_coord2 = screen_coords[bottom_index];
-		trapezoid[0].left.screen_depth1 = screen_depth[top_index];
-		trapezoid[0].left.screen_depth2 = screen_depth[bottom_index];
-		trapezoid[0].left.varyings1 = varyings[top_index];
-		trapezoid[0].left.varyings2 = varyings[bottom_index];
-		trapezoid[0].right.screen_coord1 = screen_coords[top_index];
-		trapezoid[0].right.screen_coord2 = screen_coords[middle_index];
-		trapezoid[0].right.screen_depth1 = screen_depth[top_index];
-		trapezoid[0].right.screen_depth2 = screen_depth[middle_index];
-		trapezoid[0].right.varyings1 = varyings[top_index];
-		trapezoid[0].right.varyings2 = varyings[middle_index];
-
-		// Triangle middle - bottom
-		trapezoid[1].left.screen_coord1 = screen_coords[top_index];
-		trapezoid[1].left.screen_coord2 = screen_coords[bottom_index];
-		trapezoid[1].left.screen_depth1 = screen_depth[top_index];
-		trapezoid[1].left.screen_depth2 = screen_depth[bottom_index];
-		trapezoid[1].left.varyings1 = varyings[top_index];
-		trapezoid[1].left.varyings2 = varyings[bottom_index];
-		trapezoid[1].right.screen_coord1 = screen_coords[middle_index];
-		trapezoid[1].right.screen_coord2 = screen_coords[bottom_index];
-		trapezoid[1].right.screen_depth1 = screen_depth[middle_index];
-		trapezoid[1].right.screen_depth2 = screen_depth[bottom_index];
-		trapezoid[1].right.varyings1 = varyings[middle_index];
-		trapezoid[1].right.varyings2 = varyings[bottom_index];
-	}
-	//  / T
-	// M  |
-	//  \ B
-	else
-	{
-		// Triangle top - middle
-		trapezoid[0].left.screen_coord1 = screen_coords[top_index];
-		trapezoid[0].left.screen_coord2 = screen_coords[middle_index];
-		trapezoid[0].left.screen_depth1 = screen_depth[top_index];
-		trapezoid[0].left.screen_depth2 = screen_depth[middle_index];
-		trapezoid[0].left.varyings1 = varyings[top_index];
-		trapezoid[0].left.varyings2 = varyings[middle_index];
-		trapezoid[0].right.screen_coord1 = screen_coords[top_index];
-		trapezoid[0].right.screen_coord2 = screen_coords[bottom_index];
-		trapezoid[0].right.screen_depth1 = screen_depth[top_index];
-		trapezoid[0].right.screen_depth2 = screen_depth[bottom_index];
-		trapezoid[0].right.varyings1 = varyings[top_index];
-		trapezoid[0].right.varyings2 = varyings[bottom_index];
-
-		// Triangle middle - bottom
-		trapezoid[1].left.screen_coord1 = screen_coords[middle_index];
-		trapezoid[1].left.screen_coord2 = screen_coords[bottom_index];
-		trapezoid[1].left.screen_depth1 = screen_depth[middle_index];
-		trapezoid[1].left.screen_depth2 = screen_depth[bottom_index];
-		trapezoid[1].left.varyings1 = varyings[middle_index];
-		trapezoid[1].left.varyings2 = varyings[bottom_index];
-		trapezoid[1].right.screen_coord1 = screen_coords[top_index];
-		trapezoid[1].right.screen_coord2 = screen_coords[bottom_index];
-		trapezoid[1].right.screen_depth1 = screen_depth[top_index];
-		trapezoid[1].right.screen_depth2 = screen_depth[bottom_index];
-		trapezoid[1].right.varyings1 = varyings[top_index];
-		trapezoid[1].right.varyings2 = varyings[bottom_index];
-	}
-
-	return 2;
-}
-
-static float InterpolateDepth_V1(const Trapezoid& trapezoid, float tx, float ty1, float ty2)
-{
-	const float depth0 = math::FloatLerp(trapezoid.left.screen_depth1, trapezoid.left.screen_depth2, ty1);
-	const float depth1 = math::FloatLerp(trapezoid.right.screen_depth1, trapezoid.right.screen_depth2, ty2);
-	const float depth2 = math::FloatLerp(depth0, depth1, tx);
-	return depth2;
-}
-
-static void InterpolateVaryings_V1(const Trapezoid& trapezoid, void* dst_varyings, int32_t sizeof_varyings, float tx, float ty1, float ty2)
-{
-	const int32_t num_floats = sizeof_varyings / sizeof(float);
-	const float* src_left1 = reinterpret_cast<const float*>(trapezoid.left.varyings1);
-	const float* src_left2 = reinterpret_cast<const float*>(trapezoid.left.varyings2);
-	const float* src_right1 = reinterpret_cast<const float*>(trapezoid.right.varyings1);
-	const float* src_right2 = reinterpret_cast<const float*>(trapezoid.right.varyings2);
-	float* dst = reinterpret_cast<float*>(dst_varyings);
-	for (int32_t i = 0; i < num_floats; ++i)
-	{
-		const float src0 = math::FloatLerp(src_left1[i], src_left2[i], ty1);
-		const float src1 = math::FloatLerp(src_right1[i], src_right2[i], ty2);
-		dst[i] = math::FloatLerp(src0, src1, tx);
-	}
-}
-
-struct BoundingBox
-{
-	int32_t min_x;
-	int32_t min_y;
-	int32_t max_x;
-	int32_t max_y;
-};
+static constexpr int32_t SUBPIXEL_BITS = 8;
+static constexpr int32_t SUBPIXEL_SCALE = 1 << SUBPIXEL_BITS;
+static constexpr float MAX_FIXED_POINT_COORD = 16384.0f;
+static constexpr float GUARD_BAND_PIXELS = 4096.0f;
 
 static BoundingBox MakeBoundingBox_V2(const math::Vector2 screen_coords[3], int32_t width, int32_t height)
 {
@@ -205,91 +22,95 @@ static BoundingBox MakeBoundingBox_V2(const math::Vector2 screen_coords[3], int3
 	return box;
 }
 
-static math::Vector3 CalculateWeights_V2(const math::Vector2 screen_coords[3], const math::Vector2& point)
+static rasterizer::InterpolationPlane MakeInterpolationPlane(const BarycentricPlanes_V2& barycentric, float value0, float value1, float value2)
 {
-	const math::Vector2& a = screen_coords[0];
-	const math::Vector2& b = screen_coords[1];
-	const math::Vector2& c = screen_coords[2];
-	const math::Vector2 ab = b - a;
-	const math::Vector2 ac = c - a;
-	const math::Vector2 ap = point - a;
-	const float factor = 1.0f / (ab.x * ac.y - ab.y * ac.x);
-	const float s = (ac.y * ap.x - ac.x * ap.y) * factor;
-	const float t = (ab.x * ap.y - ab.y * ap.x) * factor;
-	return math::Vector3(1.0f - s - t, s, t);
+	// value0 + (value1 - value0) * s + (value2 - value0) * t, expanded into a single plane
+	const float delta1 = value1 - value0;
+	const float delta2 = value2 - value0;
+
+	rasterizer::InterpolationPlane plane;
+	plane.origin = value0 + delta1 * barycentric.s_0 + delta2 * barycentric.t_0;
+	plane.step_x = delta1 * barycentric.s_dx + delta2 * barycentric.t_dx;
+	plane.step_y = delta1 * barycentric.s_dy + delta2 * barycentric.t_dy;
+	return plane;
 }
 
-static float InterpolateDepth_V2(const float screen_depths[3], const math::Vector3& weights)
+static rasterizer::EdgeFunction MakeEdgeFunction_V3(int32_t ax, int32_t ay, int32_t bx, int32_t by)
 {
-	const float depth0 = screen_depths[0] * weights.x;
-	const float depth1 = screen_depths[1] * weights.y;
-	const float depth2 = screen_depths[2] * weights.z;
-	return depth0 + depth1 + depth2;
-}
-
-static void InterpolateVaryings_V2(void* src_varyings[3], void* dst_varyings, int32_t sizeof_varyings, const math::Vector3& weights, const float inv_w[3])
-{
-	const int32_t num_floats = sizeof_varyings / sizeof(float);
-	const float* src0 = reinterpret_cast<const float*>(src_varyings[0]);
-	const float* src1 = reinterpret_cast<const float*>(src_varyings[1]);
-	const float* src2 = reinterpret_cast<const float*>(src_varyings[2]);
-	float* dst = reinterpret_cast<float*>(dst_varyings);
-	const float weight0 = inv_w[0] * weights.x;
-	const float weight1 = inv_w[1] * weights.y;
-	const float weight2 = inv_w[2] * weights.z;
-	const float normalizer = 1.0f / (weight0 + weight1 + weight2);
-	for (int32_t i = 0; i < num_floats; ++i)
-	{
-		const float sum = src0[i] * weight0 + src1[i] * weight1 + src2[i] * weight2;
-		dst[i] = sum * normalizer;
-	}
+	const int64_t dx = bx - ax;
+	const int64_t dy = by - ay;
+	constexpr int64_t half_pixel = SUBPIXEL_SCALE / 2;
+
+	// Top-left fill rule: pixels exactly on a right or bottom edge are not covered
+	const bool top_left = dy < 0 || (dy == 0 && dx > 0);
+
+	// E(p) = dx * (p.y - a.y) - dy * (p.x - a.x), evaluated at the center of pixel (0, 0)
+	rasterizer::EdgeFunction edge;
+	edge.bias = top_left ? 0 : -1;
+	edge.origin = dx * (half_pixel - ay) - dy * (half_pixel - ax) + edge.bias;
+	edge.step_x = -dy * SUBPIXEL_SCALE;
+	edge.step_y = dx * SUBPIXEL_SCALE;
+	return edge;
 }
 
-static bool IsBackFacing(const math::Vector3 ndc_coords[3])
+static void MakeClipPlanes(math::Vector4 planes[rasterizer::NUM_CLIP_PLANES], int32_t width, int32_t height)
 {
-	return false;
+	// The guard band keeps every vertex that is not clipped inside the fixed-point range of setup
+	const float guard_band_x = 1.0f + 2.0f * GUARD_BAND_PIXELS / static_cast<float>(width);
+	const float guard_band_y = 1.0f + 2.0f * GUARD_BAND_PIXELS / static_cast<float>(height);
+
+	// A vertex is inside a plane when dot(plane, clip_coord) >= 0
+	planes[0] = math::Vector4(0.0f, 0.0f, 1.0f, 1.0f);				// near, z >= -w
+	planes[1] = math::Vector4(0.0f, 0.0f, -1.0f, 1.0f);				// far, z <= w
+	planes[2] = math::Vector4(1.0f, 0.0f, 0.0f, guard_band_x);		// left, x >= -gx * w
+	planes[3] = math::Vector4(-1.0f, 0.0f, 0.0f, guard_band_x);		// right, x <= gx * w
+	planes[4] = math::Vector4(0.0f, 1.0f, 0.0f, guard_band_y);		// bottom, y >= -gy * w
+	planes[5] = math::Vector4(0.0f, -1.0f, 0.0f, guard_band_y);		// top, y <= gy * w
 }
 
-static math::Vector3 ViewportTransform(int32_t width, int32_t height, const math::Vector3& ndc_coords)
+static float ClipDistance(const math::Vector4& plane, const math::Vector4& clip_coord)
 {
-	const float x = (ndc_coords.x + 1.0f) * 0.5f * static_cast<float>(width);	// [-1, 1] -> [0, w]
-	const float y = (1.0f - ndc_coords.y) * 0.5f * static_cast<float>(height);	// [-1, 1] -> [0, h]
-	const float z = (ndc_coords.z + 1.0f) * 0.5f;								// [-1, 1] -> [0, 1]
-	return math::Vector3(x, y, z);
+	return plane.x * clip_coord.x + plane.y * clip_coord.y + plane.z * clip_coord.z + plane.w * clip_coord.w;
 }
 
-static void DrawFragment(const FrameBuffer& frame_buffer, PipelineContext& context, int32_t index)
+static uint32_t MakeOutCode(const math::Vector4 planes[rasterizer::NUM_CLIP_PLANES], const math::Vector4& clip_coord)
 {
-	// Execute pixel shader
-	bool discard = false;
-	math::Vector4 color = context.shader->PixelShader(context.shader_varyings, context.shader_constants, discard);
-
-	if (discard)
+	uint32_t out_code = 0;
+	for (int32_t i = 0; i < rasterizer::NUM_CLIP_PLANES; ++i)
 	{
-		return;
+		out_code |= ClipDistance(planes[i], clip_coord) < 0.0f ? (1u << i) : 0u;
 	}
 
-	color = math::Vector4Saturate(color);
+	// Outside the view volume itself, only used to reject triangles that are entirely off screen
+	const uint32_t shift = rasterizer::NUM_CLIP_PLANES;
+	out_code |= clip_coord.x < -clip_coord.w ? (1u << (shift + 0)) : 0u;
+	out_code |= clip_coord.x > clip_coord.w ? (1u << (shift + 1)) : 0u;
+	out_code |= clip_coord.y < -clip_coord.w ? (1u << (shift + 2)) : 0u;
+	out_code |= clip_coord.y > clip_coord.w ? (1u << (shift + 3)) : 0u;
+	return out_code;
+}
 
-	// Perform blending
-	if (context.enable_blend)
+static void InterpolateClipVaryings(const void* src_varyings1, const void* src_varyings2, void* dst_varyings, int32_t sizeof_varyings, float t)
+{
+	const int32_t num_floats = sizeof_varyings / sizeof(float);
+	const float* src1 = reinterpret_cast<const float*>(src_varyings1);
+	const float* src2 = reinterpret_cast<const float*>(src_varyings2);
+	float* dst = reinterpret_cast<float*>(dst_varyings);
+	for (int32_t i = 0; i < num_floats; ++i)
 	{
-		// out_color = src_color * src_alpha + dst_color * (1 - src_alpha)
-		uint8_t dst_r = frame_buffer.pixel_buffer[index * 4 + 0];
-		uint8_t dst_g = frame_buffer.pixel_buffer[index * 4 + 1];
-		uint8_t dst_b = frame_buffer.pixel_buffer[index * 4 + 2];
-		color.x = color.x * color.w + math::FloatFromUChar(dst_r) * (1.0f - color.w);
-		color.y = color.y * color.w + math::FloatFromUChar(dst_g) * (1.0f - color.w);
-		color.z = color.z * color.w + math::FloatFromUChar(dst_b) * (1.0f - color.w);
+		dst[i] = math::FloatLerp(src1[i], src2[i], t);
 	}
+}
 
-	// Output merge
-	frame_buffer.pixel_buffer[index * 4 + 0] = math::FloatToUChar(color.x); // red
-	frame_buffer.pixel_buffer[index * 4 + 1] = math::FloatToUChar(color.y); // green
-	frame_buffer.pixel_buffer[index * 4 + 2] = math::FloatToUChar(color.z); // blue
+static math::Vector3 ViewportTransform(int32_t width, int32_t height, const math::Vector3& ndc_coords)
+{
+	const float x = (ndc_coords.x + 1.0f) * 0.5f * static_cast<float>(width);	// [-1, 1] -> [0, w]
+	const float y = (1.0f - ndc_coords.y) * 0.5f * static_cast<float>(height);	// [-1, 1] -> [0, h]
+	const float z = (ndc_coords.z + 1.0f) * 0.5f;								// [-1, 1] -> [0, 1]
+	return math::Vector3(x, y, z);
 }
 
-void rasterizer::RasterizeTriangle_V1(const FrameBuffer& frame_buffer, PipelineContext& context, const math::Vector4 clip_coords[3], void* varyings[3])
+bool rasterizer::SetupTriangle(Triangle& triangle, const FrameBuffer& frame_buffer, const PipelineContext& context, const math::Vector4 clip_coords[3], void* varyings[3])
 {
 	// Perspective division
 	math::Vector3 ndc_coords[3];
@@ -299,123 +120,393 @@ void rasterizer::RasterizeTriangle_V1(const FrameBuffer& frame_buffer, PipelineC
 		ndc_coords[i] = clip_coord / clip_coords[i].w;
 	}
 
-	// Back-face culling
-	const bool backface = IsBackFacing(ndc_coords);
-	if (backface)
-	{
-		return;
-	}
-
 	// Inverse of w
-	float inv_w[3];
 	for (int32_t i = 0; i < 3; ++i)
 	{
-		inv_w[i] = 1.0f / clip_coords[i].w;
+		triangle.inv_w[i] = 1.0f / clip_coords[i].w;
 	}
 
 	// Viewport mapping
-	math::Vector2 screen_coords[3];
-	float screen_depth[3];
 	for (int32_t i = 0; i < 3; ++i)
 	{
 		const math::Vector3 viewport_coords = ViewportTransform(frame_buffer.width, frame_buffer.height, ndc_coords[i]);
-		screen_coords[i] = math::Vector2(viewport_coords.x, viewport_coords.y);
-		screen_depth[i] = ndc_coords[i].z;
+		triangle.screen_coords[i] = math::Vector2(viewport_coords.x, viewport_coords.y);
+		triangle.screen_depth[i] = ndc_coords[i].z;
+		triangle.varyings[i] = varyings[i];
 	}
 
-	Trapezoid trapezoids[2];
-	const int32_t num_triangles = MakeTrapezoid_V1(trapezoids, screen_coords, screen_depth, varyings);
+	// Rounded like the stored depths, so Hi-Z never rejects a triangle whose depth rounds onto the farthest stored one
+	triangle.min_depth = framebuffer::QuantizeDepth(frame_buffer, math::Min(math::Min(triangle.screen_depth[0], triangle.screen_depth[1]), triangle.screen_depth[2]));
+	triangle.max_depth = framebuffer::QuantizeDepth(frame_buffer, math::Max(math::Max(triangle.screen_depth[0], triangle.screen_depth[1]), triangle.screen_depth[2]));
 
-	for (int32_t i = 0; i < num_triangles; ++i)
+	triangle.bounding_box = MakeBoundingBox_V2(triangle.screen_coords, frame_buffer.width, frame_buffer.height);
+	if (triangle.bounding_box.min_x >= triangle.bounding_box.max_x || triangle.bounding_box.min_y >= triangle.bounding_box.max_y)
 	{
-		const Trapezoid& trapezoid = trapezoids[i];
+		return false;
+	}
 
-		const int32_t min_y = math::Max(math::FloorToInt(trapezoid.top + 0.5f), 0);
-		const int32_t max_y = math::Min(math::CeilToInt(trapezoid.bottom - 0.5f), frame_buffer.height);
+	// Snap to sub-pixel precision
+	int32_t fixed_x[3];
+	int32_t fixed_y[3];
+	for (int32_t i = 0; i < 3; ++i)
+	{
+		const math::Vector2& screen_coord = triangle.screen_coords[i];
+		if (!(fabsf(screen_coord.x) <= MAX_FIXED_POINT_COORD && fabsf(screen_coord.y) <= MAX_FIXED_POINT_COORD))
+		{
+			return false;
+		}
 
-		const float delta_y1 = 1.0f / (trapezoid.left.screen_coord2.y - trapezoid.left.screen_coord1.y);
-		const float delta_y2 = 1.0f / (trapezoid.right.screen_coord2.y - trapezoid.right.screen_coord1.y);
-		for (int32_t y = min_y; y < max_y; ++y)
+		fixed_x[i] = math::RoundToInt(screen_coord.x * static_cast<float>(SUBPIXEL_SCALE));
+		fixed_y[i] = math::RoundToInt(screen_coord.y * static_cast<float>(SUBPIXEL_SCALE));
+	}
+
+	const int64_t area = static_cast<int64_t>(fixed_x[1] - fixed_x[0]) * (fixed_y[2] - fixed_y[0]) - static_cast<int64_t>(fixed_y[1] - fixed_y[0]) * (fixed_x[2] - fixed_x[0]);
+	if (area == 0)
+	{
+		return false;
+	}
+
+	// Viewport mapping flips y, so a counter-clockwise triangle has a negative area on screen
+	triangle.front_facing = (area < 0) == (context.front_face == FRONT_FACE::COUNTER_CLOCKWISE);
+	triangle.primitive_id = context.primitive_id;
+
+	// Keep a single winding so the edge functions are positive inside the triangle
+	if (area < 0)
+	{
+		std::swap(triangle.screen_coords[1], triangle.screen_coords[2]);
+		std::swap(triangle.screen_depth[1], triangle.screen_depth[2]);
+		std::swap(triangle.inv_w[1], triangle.inv_w[2]);
+		std::swap(triangle.varyings[1], triangle.varyings[2]);
+		std::swap(fixed_x[1], fixed_x[2]);
+		std::swap(fixed_y[1], fixed_y[2]);
+	}
+
+	// Edge i is opposite to vertex i, so E_i / area is the weight of vertex i
+	triangle.edges[0] = MakeEdgeFunction_V3(fixed_x[1], fixed_y[1], fixed_x[2], fixed_y[2]);
+	triangle.edges[1] = MakeEdgeFunction_V3(fixed_x[2], fixed_y[2], fixed_x[0], fixed_y[0]);
+	triangle.edges[2] = MakeEdgeFunction_V3(fixed_x[0], fixed_y[0], fixed_x[1], fixed_y[1]);
+	triangle.inv_area = 1.0f / static_cast<float>(area < 0 ? -area : area);
+
+	// Plane equations of depth, 1 / w and of every declared component divided by w
+	const BarycentricPlanes_V2 barycentric = MakeBarycentricPlanes_V2(triangle.screen_coords);
+	triangle.depth_plane = MakeInterpolationPlane(barycentric, triangle.screen_depth[0], triangle.screen_depth[1], triangle.screen_depth[2]);
+	triangle.inv_w_plane = MakeInterpolationPlane(barycentric, triangle.inv_w[0], triangle.inv_w[1], triangle.inv_w[2]);
+
+	const VaryingLayout& layout = context.shader->GetVaryingLayout();
+	const float* src0 = reinterpret_cast<const float*>(triangle.varyings[0]);
+	const float* src1 = reinterpret_cast<const float*>(triangle.varyings[1]);
+	const float* src2 = reinterpret_cast<const float*>(triangle.varyings[2]);
+	triangle.num_planes = 0;
+	triangle.derivative_planes = 0;
+	for (int32_t i = 0; i < layout.num_attributes; ++i)
+	{
+		const VaryingAttribute& attribute = layout.attributes[i];
+		SR_ASSERT((attribute.offset + attribute.num_components) * static_cast<int32_t>(sizeof(float)) <= context.sizeof_varyings);
+		for (int32_t j = 0; j < attribute.num_components; ++j)
 		{
-			const float fy = static_cast<float>(y) + 0.5f;
-			const float ty1 = (fy - trapezoid.left.screen_coord1.y) * delta_y1;
-			const float ty2 = (fy - trapezoid.right.screen_coord1.y) * delta_y2;
-			const float fx1 = math::FloatLerp(trapezoid.left.screen_coord1.x, trapezoid.left.screen_coord2.x, ty1);
-			const float fx2 = math::FloatLerp(trapezoid.right.screen_coord1.x, trapezoid.right.screen_coord2.x, ty2);
-			const int32_t min_x = math::Max(math::FloorToInt(fx1 + 0.5f), 0);
-			const int32_t max_x = math::Min(math::CeilToInt(fx2 - 0.5f), frame_buffer.width);
-
-			const float delta_x = 1.0f / (fx2 - fx1);
-			for (int32_t x = min_x; x < max_x; ++x)
+			SR_ASSERT(triangle.num_planes < MAX_VARYING_COMPONENTS);
+			const int32_t component = attribute.offset + j;
+			triangle.plane_components[triangle.num_planes] = static_cast<uint8_t>(component);
+			if (attribute.derivatives)
 			{
-				const float fx = static_cast<float>(x) + 0.5f;
-				const float tx = (fx - fx1) * delta_x;
-				const int32_t index = y * frame_buffer.width + x;
-				const float depth = InterpolateDepth_V1(trapezoid, tx, ty1, ty2);
-				// Depth test
-				if (depth <= frame_buffer.depth_buffer[index])
-				{
-					InterpolateVaryings_V1(trapezoid, context.shader_varyings, context.sizeof_varyings, tx, ty1, ty2);
-					DrawFragment(frame_buffer, context, index);
-				}
+				triangle.derivative_planes |= 1u << triangle.num_planes;
 			}
+
+			triangle.planes[triangle.num_planes] = MakeInterpolationPlane(barycentric, src0[component] * triangle.inv_w[0], src1[component] * triangle.inv_w[1], src2[component] * triangle.inv_w[2]);
+			++triangle.num_planes;
 		}
 	}
+
+	return true;
 }
 
-void rasterizer::RasterizeTriangle_V2(const FrameBuffer& frame_buffer, PipelineContext& context, const math::Vector4 clip_coords[3], void* varyings[3])
+int32_t rasterizer::CullTriangles(int32_t* visible_triangles, const PipelineContext& context, const math::Vector4* clip_coords, int32_t num_triangles)
 {
-	// Perspective division
-	math::Vector3 ndc_coords[3];
-	for (int32_t i = 0; i < 3; ++i)
+	// Two-sided materials keep their back faces and shade them with front_facing = false
+	const CULL_MODE cull_mode = context.two_sided ? CULL_MODE::NONE : context.cull_mode;
+	if (cull_mode == CULL_MODE::NONE)
 	{
-		const math::Vector3 clip_coord = math::Vector3(clip_coords[i].x, clip_coords[i].y, clip_coords[i].z);
-		ndc_coords[i] = clip_coord / clip_coords[i].w;
+		for (int32_t i = 0; i < num_triangles; ++i)
+		{
+			visible_triangles[i] = i;
+		}
+		return num_triangles;
 	}
 
-	// Back-face culling
-	const bool backface = IsBackFacing(ndc_coords);
-	if (backface)
+	// The sign flips for clockwise fronts and again when front faces are culled
+	const float sign = (context.front_face == FRONT_FACE::COUNTER_CLOCKWISE ? 1.0f : -1.0f) * (cull_mode == CULL_MODE::BACK ? 1.0f : -1.0f);
+
+	int32_t num_visible = 0;
+	for (int32_t i = 0; i < num_triangles; ++i)
 	{
-		return;
+		const math::Vector4& a = clip_coords[i * 3 + 0];
+		const math::Vector4& b = clip_coords[i * 3 + 1];
+		const math::Vector4& c = clip_coords[i * 3 + 2];
+
+		// det(a.xyw, b.xyw, c.xyw) has the sign of the projected area, no perspective division or clipping needed
+		const float det = a.x * (b.y * c.w - c.y * b.w) - a.y * (b.x * c.w - c.x * b.w) + a.w * (b.x * c.y - c.x * b.y);
+
+		// Compact without branching, the slot is simply overwritten when the triangle is culled
+		visible_triangles[num_visible] = i;
+		num_visible += det * sign > 0.0f ? 1 : 0;
 	}
 
-	// Inverse of w
-	float inv_w[3];
+	return num_visible;
+}
+
+int32_t rasterizer::ClipTriangle(math::Vector4 out_clip_coords[MAX_CLIP_VERTICES], void* out_varyings[MAX_CLIP_VERTICES], const FrameBuffer& frame_buffer, PipelineContext& context, const math::Vector4 clip_coords[3], void* varyings[3])
+{
+	math::Vector4 planes[NUM_CLIP_PLANES];
+	MakeClipPlanes(planes, frame_buffer.width, frame_buffer.height);
+
+	uint32_t and_code = ~0u;
+	uint32_t or_code = 0;
 	for (int32_t i = 0; i < 3; ++i)
 	{
-		inv_w[i] = 1.0f / clip_coords[i].w;
+		const uint32_t out_code = MakeOutCode(planes, clip_coords[i]);
+		and_code &= out_code;
+		or_code |= out_code;
+	}
+
+	// All vertices are outside the same plane
+	if (and_code != 0)
+	{
+		return 0;
 	}
 
-	// Viewport mapping
-	math::Vector2 screen_coords[3];
-	float screen_depth[3];
 	for (int32_t i = 0; i < 3; ++i)
 	{
-		const math::Vector3 viewport_coords = ViewportTransform(frame_buffer.width, frame_buffer.height, ndc_coords[i]);
-		screen_coords[i] = math::Vector2(viewport_coords.x, viewport_coords.y);
-		screen_depth[i] = ndc_coords[i].z;
+		out_clip_coords[i] = clip_coords[i];
+		out_varyings[i] = varyings[i];
 	}
 
-	const BoundingBox box = MakeBoundingBox_V2(screen_coords, frame_buffer.width, frame_buffer.height);
+	// Triangles inside the guard band are rasterized as they are, the clip rect takes care of the screen edges
+	const uint32_t clip_code = or_code & ((1u << NUM_CLIP_PLANES) - 1);
+	if (clip_code == 0)
+	{
+		return 3;
+	}
+
+	SR_ASSERT(context.clip_varyings);
+	uint8_t* clip_varyings = reinterpret_cast<uint8_t*>(context.clip_varyings);
+	int32_t num_clip_varyings = 0;
+
+	// Sutherland-Hodgman, only against the planes some vertex is actually outside of
+	math::Vector4 in_clip_coords[MAX_CLIP_VERTICES];
+	void* in_varyings[MAX_CLIP_VERTICES];
+	int32_t num_vertices = 3;
+	for (int32_t plane_index = 0; plane_index < NUM_CLIP_PLANES; ++plane_index)
+	{
+		if ((clip_code & (1u << plane_index)) == 0)
+		{
+			continue;
+		}
+
+		std::copy_n(out_clip_coords, num_vertices, in_clip_coords);
+		std::copy_n(out_varyings, num_vertices, in_varyings);
+		const int32_t num_in_vertices = num_vertices;
+		num_vertices = 0;
+
+		for (int32_t i = 0; i < num_in_vertices; ++i)
+		{
+			const int32_t j = (i + 1) % num_in_vertices;
+			const float distance_i = ClipDistance(planes[plane_index], in_clip_coords[i]);
+			const float distance_j = ClipDistance(planes[plane_index], in_clip_coords[j]);
+			const bool inside_i = distance_i >= 0.0f;
+			const bool inside_j = distance_j >= 0.0f;
+
+			if (inside_i)
+			{
+				out_clip_coords[num_vertices] = in_clip_coords[i];
+				out_varyings[num_vertices] = in_varyings[i];
+				++num_vertices;
+			}
+
+			if (inside_i != inside_j)
+			{
+				// Always interpolate from the inside vertex, so an edge shared by two triangles is split at the same point
+				const int32_t inside = inside_i ? i : j;
+				const int32_t outside = inside_i ? j : i;
+				const float distance_inside = inside_i ? distance_i : distance_j;
+				const float distance_outside = inside_i ? distance_j : distance_i;
+				const float t = distance_inside / (distance_inside - distance_outside);
+
+				SR_ASSERT(num_clip_varyings < MAX_CLIP_VARYINGS);
+				void* new_varyings = clip_varyings + num_clip_varyings * context.sizeof_varyings;
+				++num_clip_varyings;
+
+				InterpolateClipVaryings(in_varyings[inside], in_varyings[outside], new_varyings, context.sizeof_varyings, t);
+				out_clip_coords[num_vertices] = math::Vector4Lerp(in_clip_coords[inside], in_clip_coords[outside], t);
+				out_varyings[num_vertices] = new_varyings;
+				++num_vertices;
+			}
+		}
+
+		if (num_vertices < 3)
+		{
+			return 0;
+		}
+	}
+
+	return num_vertices;
+}
+
+void rasterizer::DrawTriangle(const FrameBuffer& frame_buffer, PipelineContext& context, const math::Vector4 clip_coords[3], void* varyings[3], RasterizeFunction rasterize_function)
+{
+	math::Vector4 polygon_clip_coords[MAX_CLIP_VERTICES];
+	void* polygon_varyings[MAX_CLIP_VERTICES];
+	const int32_t num_vertices = ClipTriangle(polygon_clip_coords, polygon_varyings, frame_buffer, context, clip_coords, varyings);
+
+	// The clipped polygon is convex, so a fan around its first vertex covers it
+	for (int32_t i = 1; i + 1 < num_vertices; ++i)
+	{
+		const math::Vector4 fan_clip_coords[3] = { polygon_clip_coords[0], polygon_clip_coords[i], polygon_clip_coords[i + 1] };
+		void* fan_varyings[3] = { polygon_varyings[0], polygon_varyings[i], polygon_varyings[i + 1] };
+
+		Triangle triangle;
+		if (SetupTriangle(triangle, frame_buffer, context, fan_clip_coords, fan_varyings))
+		{
+			rasterize_function(frame_buffer, context, triangle, triangle.bounding_box);
+		}
+	}
+}
+
+void rasterizer::RasterizeTriangle_V1(const FrameBuffer& frame_buffer, PipelineContext& context, const math::Vector4 clip_coords[3], void* varyings[3])
+{
+	DrawTriangle(frame_buffer, context, clip_coords, varyings, RasterizeTriangle_V1);
+}
+
+void rasterizer::RasterizeTriangle_V1(const FrameBuffer& frame_buffer, PipelineContext& context, const Triangle& triangle, const BoundingBox& clip_rect)
+{
+	RasterizeKernel_V1<DynamicPipeline>(frame_buffer, context, triangle, clip_rect);
+}
+
+void rasterizer::RasterizeTriangle_V2(const FrameBuffer& frame_buffer, PipelineContext& context, const math::Vector4 clip_coords[3], void* varyings[3])
+{
+	DrawTriangle(frame_buffer, context, clip_coords, varyings, RasterizeTriangle_V2);
+}
+
+void rasterizer::RasterizeTriangle_V2(const FrameBuffer& frame_buffer, PipelineContext& context, const Triangle& triangle, const BoundingBox& clip_rect)
+{
+	RasterizeKernel_V2<DynamicPipeline>(frame_buffer, context, triangle, clip_rect);
+}
 
-	for (int32_t x = box.min_x; x < box.max_x; ++x)
+void rasterizer::RasterizeTriangle_V3(const FrameBuffer& frame_buffer, PipelineContext& context, const math::Vector4 clip_coords[3], void* varyings[3])
+{
+	DrawTriangle(frame_buffer, context, clip_coords, varyings, RasterizeTriangle_V3);
+}
+
+void rasterizer::RasterizeTriangle_V3(const FrameBuffer& frame_buffer, PipelineContext& context, const Triangle& triangle, const BoundingBox& clip_rect)
+{
+	RasterizeKernel_V3<DynamicPipeline>(frame_buffer, context, triangle, clip_rect);
+}
+
+/* Block traversal of V3 without varyings or shading, the visibility pass also stores the primitive id of every passing pixel */
+template<bool VISIBILITY>
+static void RasterizeDepthKernel(const FrameBuffer& frame_buffer, PipelineContext& context, const rasterizer::Triangle& triangle, const BoundingBox& clip_rect)
+{
+	const int32_t min_x = math::Max(triangle.bounding_box.min_x, clip_rect.min_x);
+	const int32_t min_y = math::Max(triangle.bounding_box.min_y, clip_rect.min_y);
+	const int32_t max_x = math::Min(triangle.bounding_box.max_x, clip_rect.max_x);
+	const int32_t max_y = math::Min(triangle.bounding_box.max_y, clip_rect.max_y);
+
+	const rasterizer::EdgeFunction* edges = triangle.edges;
+	const bool depth_write = context.depth_test && context.depth_write;
+	DepthRow depth_row;
+	depth_row.mask = 0;
+
+	for (int32_t block_y = min_y & ~(BLOCK_SIZE - 1); block_y < max_y; block_y += BLOCK_SIZE)
 	{
-		for (int32_t y = box.min_y; y < box.max_y; ++y)
+		for (int32_t block_x = min_x & ~(BLOCK_SIZE - 1); block_x < max_x; block_x += BLOCK_SIZE)
 		{
-			const math::Vector2 point = math::Vector2(static_cast<float>(x) + 0.5f, static_cast<float>(y) + 0.5f);
-			const math::Vector3 weights = CalculateWeights_V2(screen_coords, point);
-			if (0.0f < weights.x && 0.0f < weights.y && 0.0f < weights.z)
+			BoundingBox block;
+			block.min_x = math::Max(block_x, min_x);
+			block.min_y = math::Max(block_y, min_y);
+			block.max_x = math::Min(block_x + BLOCK_SIZE, max_x);
+			block.max_y = math::Min(block_y + BLOCK_SIZE, max_y);
+
+			if (!PassHiZ(frame_buffer, context, triangle, block_x / HIZ_TILE_SIZE, block_y / HIZ_TILE_SIZE))
 			{
-				const int32_t index = y * frame_buffer.width + x;
-				const float depth = InterpolateDepth_V2(screen_depth, weights);
-				// Depth test
-				if (depth <= frame_buffer.depth_buffer[index])
+				continue;
+			}
+
+			const BLOCK_COVERAGE coverage = ClassifyBlock_V3(edges, block);
+			if (coverage == BLOCK_COVERAGE::OUTSIDE)
+			{
+				continue;
+			}
+
+			PrepareBlock(frame_buffer, context, triangle, block, coverage, false);
+
+			for (int32_t y = block.min_y; y < block.max_y; ++y)
+			{
+				int64_t e0 = edges[0].origin + edges[0].step_x * block.min_x + edges[0].step_y * y;
+				int64_t e1 = edges[1].origin + edges[1].step_x * block.min_x + edges[1].step_y * y;
+				int64_t e2 = edges[2].origin + edges[2].step_x * block.min_x + edges[2].step_y * y;
+
+				for (int32_t x = block.min_x; x < block.max_x; ++x)
 				{
-					InterpolateVaryings_V2(varyings, context.shader_varyings, context.sizeof_varyings, weights, inv_w);
-					DrawFragment(frame_buffer, context, index);
+					if (coverage == BLOCK_COVERAGE::INSIDE || (e0 | e1 | e2) >= 0)
+					{
+						const math::Vector3 weights = math::Vector3(
+							static_cast<float>(e0 - edges[0].bias) * triangle.inv_area,
+							static_cast<float>(e1 - edges[1].bias) * triangle.inv_area,
+							static_cast<float>(e2 - edges[2].bias) * triangle.inv_area);
+
+						const int32_t index = framebuffer::PixelOffset(frame_buffer, x, y);
+						const float depth = InterpolateDepth_V2(triangle.screen_depth, weights);
+						if (PassDepthTest(context, framebuffer::QuantizeDepth(frame_buffer, depth), framebuffer::LoadDepth(frame_buffer, index)))
+						{
+							if (depth_write)
+							{
+								depth_row.depths[x - block_x] = depth;
+								depth_row.mask |= 1u << (x - block_x);
+							}
+
+							if (VISIBILITY)
+							{
+								frame_buffer.visibility_buffer[index] = triangle.primitive_id;
+							}
+						}
+					}
+
+					e0 += edges[0].step_x;
+					e1 += edges[1].step_x;
+					e2 += edges[2].step_x;
 				}
+
+				WriteDepthRow(frame_buffer, block_x, y, depth_row);
 			}
 		}
 	}
 }
+
+void rasterizer::RasterizeVisibility(const FrameBuffer& frame_buffer, PipelineContext& context, const Triangle& triangle, const BoundingBox& clip_rect)
+{
+	SR_ASSERT(frame_buffer.visibility_buffer);
+	RasterizeDepthKernel<true>(frame_buffer, context, triangle, clip_rect);
+}
+
+void rasterizer::RasterizeDepth(const FrameBuffer& frame_buffer, PipelineContext& context, const Triangle& triangle, const BoundingBox& clip_rect)
+{
+	RasterizeDepthKernel<false>(frame_buffer, context, triangle, clip_rect);
+}
+
+void rasterizer::ShadeTrianglePixels(const FrameBuffer& frame_buffer, PipelineContext& context, const Triangle& triangle, const int32_t* pixel_indices, int32_t num_pixels)
+{
+	FragmentBatch batch;
+	batch.count = 0;
+
+	// The stored depth is the depth of this triangle, so nothing is tested or written again
+	for (int32_t i = 0; i < num_pixels; ++i)
+	{
+		const int32_t index = pixel_indices[i];
+		const Point pixel = framebuffer::PixelCoords(frame_buffer, index);
+		AppendFragment(batch, pixel.x, pixel.y, framebuffer::LoadDepth(frame_buffer, index));
+		if (batch.count == PIXEL_BATCH_SIZE || i + 1 == num_pixels)
+		{
+			InterpolateFragments(batch, triangle, context);
+			ShadeFragments<DynamicPipeline>(frame_buffer, context, batch, triangle, false);
+		}
+	}
+}
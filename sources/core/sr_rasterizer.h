@@ -17,9 +17,86 @@ namespace rasterizer
 	 * Output Merge
 	 */
 
-	 /* 1.rasterization scanline */
+	/* E(x, y) = origin + step_x * x + step_y * y, sampled at pixel centers in 24.8 fixed point */
+	struct EdgeFunction
+	{
+		int64_t origin;
+		int64_t step_x;
+		int64_t step_y;
+		int64_t bias;
+	};
+
+	/* f(x, y) = origin + step_x * x + step_y * y, sampled at pixel centers */
+	struct InterpolationPlane
+	{
+		float origin;
+		float step_x;
+		float step_y;
+	};
+
+	struct Triangle
+	{
+		math::Vector2 screen_coords[3];
+		float screen_depth[3];
+		float min_depth;
+		float max_depth;
+		float inv_w[3];
+		void* varyings[3];
+		BoundingBox bounding_box;
+		EdgeFunction edges[3];
+		float inv_area;
+		bool front_facing;
+		uint32_t primitive_id;
+		/* depth, 1 / w and every interpolated component divided by w are linear in screen space */
+		InterpolationPlane depth_plane;
+		InterpolationPlane inv_w_plane;
+		int32_t num_planes;
+		uint32_t derivative_planes;
+		uint8_t plane_components[MAX_VARYING_COMPONENTS];
+		InterpolationPlane planes[MAX_VARYING_COMPONENTS];
+	};
+
+	using RasterizeFunction = void(*)(const FrameBuffer& frame_buffer, PipelineContext& context, const Triangle& triangle, const BoundingBox& clip_rect);
+
+	/* Near, far and the four guard band planes, every plane adds at most one vertex and two new varyings */
+	constexpr int32_t NUM_CLIP_PLANES = 6;
+	constexpr int32_t MAX_CLIP_VERTICES = 3 + NUM_CLIP_PLANES;
+	constexpr int32_t MAX_CLIP_VARYINGS = 2 * NUM_CLIP_PLANES;
+
+	/* 0.back-face culling of a triangle list in clip space, writes the indices of the remaining triangles and returns their count */
+	int32_t CullTriangles(int32_t* visible_triangles, const PipelineContext& context, const math::Vector4* clip_coords, int32_t num_triangles);
+
+	/* 0.clipping in homogeneous space, returns the vertex count of the convex polygon, 0 if the triangle is rejected */
+	int32_t ClipTriangle(math::Vector4 out_clip_coords[MAX_CLIP_VERTICES], void* out_varyings[MAX_CLIP_VERTICES], const FrameBuffer& frame_buffer, PipelineContext& context, const math::Vector4 clip_coords[3], void* varyings[3]);
+
+	/* 0.triangle setup, returns false if the triangle covers no pixel */
+	bool SetupTriangle(Triangle& triangle, const FrameBuffer& frame_buffer, const PipelineContext& context, const math::Vector4 clip_coords[3], void* varyings[3]);
+
+	/* clipping, setup and rasterization of a single triangle */
+	void DrawTriangle(const FrameBuffer& frame_buffer, PipelineContext& context, const math::Vector4 clip_coords[3], void* varyings[3], RasterizeFunction rasterize_function);
+
+	/* 1.rasterization scanline */
 	void RasterizeTriangle_V1(const FrameBuffer& frame_buffer, PipelineContext& context, const math::Vector4 clip_coords[3], void* varyings[3]);
+	void RasterizeTriangle_V1(const FrameBuffer& frame_buffer, PipelineContext& context, const Triangle& triangle, const BoundingBox& clip_rect);
 
 	/* 2.rasterization barycentric coordinate */
 	void RasterizeTriangle_V2(const FrameBuffer& frame_buffer, PipelineContext& context, const math::Vector4 clip_coords[3], void* varyings[3]);
+	void RasterizeTriangle_V2(const FrameBuffer& frame_buffer, PipelineContext& context, const Triangle& triangle, const BoundingBox& clip_rect);
+
+	/* 3.rasterization fixed-point edge function */
+	void RasterizeTriangle_V3(const FrameBuffer& frame_buffer, PipelineContext& context, const math::Vector4 clip_coords[3], void* varyings[3]);
+	void RasterizeTriangle_V3(const FrameBuffer& frame_buffer, PipelineContext& context, const Triangle& triangle, const BoundingBox& clip_rect);
+
+	/* visibility pass, depth test and primitive id only, the pixel shader runs later in ShadeTrianglePixels */
+	void RasterizeVisibility(const FrameBuffer& frame_buffer, PipelineContext& context, const Triangle& triangle, const BoundingBox& clip_rect);
+
+	/* depth-only pass, depth test and depth writes without running the pixel shader or writing colors */
+	void RasterizeDepth(const FrameBuffer& frame_buffer, PipelineContext& context, const Triangle& triangle, const BoundingBox& clip_rect);
+
+	/* pixel stage of the given pixels as if the triangle had been rasterized there, depth is already resolved */
+	void ShadeTrianglePixels(const FrameBuffer& frame_buffer, PipelineContext& context, const Triangle& triangle, const int32_t* pixel_indices, int32_t num_pixels);
+
+	/* kernel of rasterize_function specialized for the shader and state of the context, rasterize_function itself if none was built,
+	 * defined with the registry of shader kernels in shaders/sr_shader_kernels.cpp */
+	RasterizeFunction SelectRasterizeFunction(RasterizeFunction rasterize_function, const PipelineContext& context);
 }
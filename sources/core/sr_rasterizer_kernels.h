@@ -0,0 +1,1147 @@
+#pragma once
+
+#include "core/sr_core_types.h"
+#include "core/sr_frame_buffer.h"
+#include "core/sr_math.h"
+#include "core/sr_rasterizer.h"
+#include "core/sr_simd.h"
+#include "shaders/sr_shader_interface.h"
+
+/*
+ * Rasterizer kernels as templates over the pipeline state
+ * sr_rasterizer.cpp instantiates them with DynamicPipeline for the generic RasterizeTriangle functions and
+ * the shader kernel registry with a SpecializedPipeline per shader, so the rasterizer knows no concrete shader.
+ */
+
+// Rows of a block never straddle two tiles of a tiled frame buffer
+constexpr int32_t BLOCK_SIZE = HIZ_TILE_SIZE;
+// Every covered pixel of a block is shaded by a single ShadePixels call
+static_assert(BLOCK_SIZE * BLOCK_SIZE == PIXEL_BATCH_SIZE, "a block must fill exactly one pixel batch");
+
+struct Edge
+{
+	math::Vector2 screen_coord1;
+	math::Vector2 screen_coord2;
+};
+
+struct Trapezoid
+{
+	float top;
+	float bottom;
+	Edge left;
+	Edge right;
+};
+
+inline int32_t MakeTrapezoid_V1(Trapezoid trapezoid[2], const math::Vector2 screen_coords[3])
+{
+	int32_t top_index = 0;
+	int32_t middle_index = 1;
+	int32_t bottom_index = 2;
+
+	if (screen_coords[top_index].y > screen_coords[middle_index].y) { std::swap(top_index, middle_index); }
+	if (screen_coords[top_index].y > screen_coords[bottom_index].y) { std::swap(top_index, bottom_index); }
+	if (screen_coords[middle_index].y > screen_coords[bottom_index].y) { std::swap(middle_index, bottom_index); }
+	if (screen_coords[top_index].x == screen_coords[middle_index].x && screen_coords[middle_index].x == screen_coords[bottom_index].x) { return 0; }
+	if (screen_coords[top_index].y == screen_coords[middle_index].y && screen_coords[middle_index].y == screen_coords[bottom_index].y) { return 0; }
+
+	//    T
+	//  /   \
+	// M  -  B
+	if (screen_coords[top_index].y != screen_coords[middle_index].y && screen_coords[middle_index].y == screen_coords[bottom_index].y)
+	{
+		if (screen_coords[middle_index].x > screen_coords[bottom_index].x) { std::swap(middle_index, bottom_index); }
+
+		trapezoid[0].top = screen_coords[top_index].y;
+		trapezoid[0].bottom = screen_coords[bottom_index].y;
+		trapezoid[0].left.screen_coord1 = screen_coords[top_index];
+		trapezoid[0].left.screen_coord2 = screen_coords[middle_index];
+		trapezoid[0].right.screen_coord1 = screen_coords[top_index];
+		trapezoid[0].right.screen_coord2 = screen_coords[bottom_index];
+		return 1;
+	}
+
+	// T  -  M
+	//  \   /
+	//    B
+	if (screen_coords[top_index].y == screen_coords[middle_index].y && screen_coords[middle_index].y != screen_coords[bottom_index].y)
+	{
+		if (screen_coords[top_index].x > screen_coords[middle_index].x) { std::swap(top_index, middle_index); }
+
+		trapezoid[0].top = screen_coords[top_index].y;
+		trapezoid[0].bottom = screen_coords[bottom_index].y;
+		trapezoid[0].left.screen_coord1 = screen_coords[top_index];
+		trapezoid[0].left.screen_coord2 = screen_coords[bottom_index];
+		trapezoid[0].right.screen_coord1 = screen_coords[middle_index];
+		trapezoid[0].right.screen_coord2 = screen_coords[bottom_index];
+		return 1;
+	}
+
+	// T \      / T
+	// |  M or M  |
+	// B /      \ B
+	const float t = (screen_coords[middle_index].y - screen_coords[top_index].y) / (screen_coords[bottom_index].y - screen_coords[top_index].y);
+	const float x = screen_coords[top_index].x + (screen_coords[bottom_index].x - screen_coords[top_index].x) * t;
+
+	trapezoid[0].top = screen_coords[top_index].y;
+	trapezoid[0].bottom = screen_coords[middle_index].y;
+	trapezoid[1].top = screen_coords[middle_index].y;
+	trapezoid[1].bottom = screen_coords[bottom_index].y;
+
+	// T \ 
+	// |  M
+	// B / 
+	if (screen_coords[middle_index].x > x)
+	{
+		// Triangle top - middle
+		trapezoid[0].left.screen_coord1 = screen_coords[top_index];
+		trapezoid[0].left.screen_coord2 = screen_coords[bottom_index];
+		trapezoid[0].right.screen_coord1 = screen_coords[top_index];
+		trapezoid[0].right.screen_coord2 = screen_coords[middle_index];
+
+		// Triangle middle - bottom
+		trapezoid[1].left.screen_coord1 = screen_coords[top_index];
+		trapezoid[1].left.screen_coord2 = screen_coords[bottom_index];
+		trapezoid[1].right.screen_coord1 = screen_coords[middle_index];
+		trapezoid[1].right.screen_coord2 = screen_coords[bottom_index];
+	}
+	//  / T
+	// M  |
+	//  \ B
+	else
+	{
+		// Triangle top - middle
+		trapezoid[0].left.screen_coord1 = screen_coords[top_index];
+		trapezoid[0].left.screen_coord2 = screen_coords[middle_index];
+		trapezoid[0].right.screen_coord1 = screen_coords[top_index];
+		trapezoid[0].right.screen_coord2 = screen_coords[bottom_index];
+
+		// Triangle middle - bottom
+		trapezoid[1].left.screen_coord1 = screen_coords[middle_index];
+		trapezoid[1].left.screen_coord2 = screen_coords[bottom_index];
+		trapezoid[1].right.screen_coord1 = screen_coords[top_index];
+		trapezoid[1].right.screen_coord2 = screen_coords[bottom_index];
+	}
+
+	return 2;
+}
+
+struct BarycentricPlanes_V2
+{
+	float s_dx;
+	float s_dy;
+	float s_0;
+	float t_dx;
+	float t_dy;
+	float t_0;
+};
+
+inline BarycentricPlanes_V2 MakeBarycentricPlanes_V2(const math::Vector2 screen_coords[3])
+{
+	const math::Vector2& a = screen_coords[0];
+	const math::Vector2& b = screen_coords[1];
+	const math::Vector2& c = screen_coords[2];
+	const math::Vector2 ab = b - a;
+	const math::Vector2 ac = c - a;
+	const float factor = 1.0f / (ab.x * ac.y - ab.y * ac.x);
+
+	BarycentricPlanes_V2 planes;
+	planes.s_dx = ac.y * factor;
+	planes.s_dy = -ac.x * factor;
+	planes.s_0 = (ac.x * a.y - ac.y * a.x) * factor;
+	planes.t_dx = -ab.y * factor;
+	planes.t_dy = ab.x * factor;
+	planes.t_0 = (ab.y * a.x - ab.x * a.y) * factor;
+	return planes;
+}
+
+enum class BLOCK_COVERAGE : uint8_t
+{
+	OUTSIDE,
+	PARTIAL,
+	INSIDE,
+};
+
+inline void PlaneRange_V2(float dx, float dy, float origin, const BoundingBox& block, float& min, float& max)
+{
+	// A plane takes its extremes at the corner samples of the block
+	const float x0 = dx * (static_cast<float>(block.min_x) + 0.5f);
+	const float x1 = dx * (static_cast<float>(block.max_x) - 0.5f);
+	const float y0 = dy * (static_cast<float>(block.min_y) + 0.5f);
+	const float y1 = dy * (static_cast<float>(block.max_y) - 0.5f);
+	min = origin + math::Min(x0, x1) + math::Min(y0, y1);
+	max = origin + math::Max(x0, x1) + math::Max(y0, y1);
+}
+
+inline BLOCK_COVERAGE ClassifyBlock_V2(const BarycentricPlanes_V2& planes, const BoundingBox& block)
+{
+	float min_s, max_s, min_t, max_t, min_r, max_r;
+	PlaneRange_V2(planes.s_dx, planes.s_dy, planes.s_0, block, min_s, max_s);
+	PlaneRange_V2(planes.t_dx, planes.t_dy, planes.t_0, block, min_t, max_t);
+	PlaneRange_V2(-planes.s_dx - planes.t_dx, -planes.s_dy - planes.t_dy, 1.0f - planes.s_0 - planes.t_0, block, min_r, max_r);
+
+	if (max_s <= 0.0f || max_t <= 0.0f || max_r <= 0.0f)
+	{
+		return BLOCK_COVERAGE::OUTSIDE;
+	}
+
+	if (min_s > 0.0f && min_t > 0.0f && min_r > 0.0f)
+	{
+		return BLOCK_COVERAGE::INSIDE;
+	}
+
+	return BLOCK_COVERAGE::PARTIAL;
+}
+
+inline float InterpolateDepth_V2(const float screen_depths[3], const math::Vector3& weights)
+{
+	const float depth0 = screen_depths[0] * weights.x;
+	const float depth1 = screen_depths[1] * weights.y;
+	const float depth2 = screen_depths[2] * weights.z;
+	return depth0 + depth1 + depth2;
+}
+
+inline BLOCK_COVERAGE ClassifyBlock_V3(const rasterizer::EdgeFunction edges[3], const BoundingBox& block)
+{
+	bool inside = true;
+	for (int32_t i = 0; i < 3; ++i)
+	{
+		// An edge function takes its extremes at the corner samples of the block
+		const rasterizer::EdgeFunction& edge = edges[i];
+		const int64_t corner = edge.origin + edge.step_x * block.min_x + edge.step_y * block.min_y;
+		const int64_t delta_x = edge.step_x * (block.max_x - 1 - block.min_x);
+		const int64_t delta_y = edge.step_y * (block.max_y - 1 - block.min_y);
+		const int64_t max = corner + std::max<int64_t>(delta_x, 0) + std::max<int64_t>(delta_y, 0);
+		const int64_t min = corner + std::min<int64_t>(delta_x, 0) + std::min<int64_t>(delta_y, 0);
+
+		if (max < 0)
+		{
+			return BLOCK_COVERAGE::OUTSIDE;
+		}
+
+		if (min < 0)
+		{
+			inside = false;
+		}
+	}
+
+	return inside ? BLOCK_COVERAGE::INSIDE : BLOCK_COVERAGE::PARTIAL;
+}
+
+inline float GetHiZDepth(const FrameBuffer& frame_buffer, int32_t tile_x, int32_t tile_y)
+{
+	const int32_t num_tiles_x = (frame_buffer.width + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+	const int32_t tile_index = tile_y * num_tiles_x + tile_x;
+
+	// Depth writes only mark the tile, the farthest depth is rebuilt the next time the tile is tested
+	if (frame_buffer.hiz_dirty[tile_index])
+	{
+		const int32_t min_x = tile_x * HIZ_TILE_SIZE;
+		const int32_t min_y = tile_y * HIZ_TILE_SIZE;
+		const int32_t max_x = math::Min(min_x + HIZ_TILE_SIZE, frame_buffer.width);
+		const int32_t max_y = math::Min(min_y + HIZ_TILE_SIZE, frame_buffer.height);
+
+		float max_depth = framebuffer::LoadDepth(frame_buffer, framebuffer::PixelOffset(frame_buffer, min_x, min_y));
+		for (int32_t y = min_y; y < max_y; ++y)
+		{
+			const int32_t row_offset = framebuffer::RowOffset(frame_buffer, min_x, y);
+			for (int32_t x = min_x; x < max_x; ++x)
+			{
+				max_depth = math::Max(max_depth, framebuffer::LoadDepth(frame_buffer, row_offset + x));
+			}
+		}
+
+		frame_buffer.hiz_buffer[tile_index] = max_depth;
+		frame_buffer.hiz_dirty[tile_index] = 0;
+	}
+
+	return frame_buffer.hiz_buffer[tile_index];
+}
+
+template<DEPTH_FUNC FUNC>
+inline bool CompareHiZ(const FrameBuffer& frame_buffer, const rasterizer::Triangle& triangle, int32_t tile_x, int32_t tile_y)
+{
+	// Only the nearer-wins functions can reject against the farthest depth of a tile
+	if constexpr (FUNC == DEPTH_FUNC::NEVER)
+	{
+		return false;
+	}
+	else if constexpr (FUNC == DEPTH_FUNC::LESS)
+	{
+		return triangle.min_depth < GetHiZDepth(frame_buffer, tile_x, tile_y);
+	}
+	else if constexpr (FUNC == DEPTH_FUNC::LESS_EQUAL)
+	{
+		return triangle.min_depth <= GetHiZDepth(frame_buffer, tile_x, tile_y);
+	}
+	else
+	{
+		return true;
+	}
+}
+
+template<DEPTH_FUNC FUNC>
+inline bool CompareDepth(float depth, float dst_depth)
+{
+	if constexpr (FUNC == DEPTH_FUNC::NEVER)
+	{
+		return false;
+	}
+	else if constexpr (FUNC == DEPTH_FUNC::LESS)
+	{
+		return depth < dst_depth;
+	}
+	else if constexpr (FUNC == DEPTH_FUNC::EQUAL)
+	{
+		return depth == dst_depth;
+	}
+	else if constexpr (FUNC == DEPTH_FUNC::LESS_EQUAL)
+	{
+		return depth <= dst_depth;
+	}
+	else if constexpr (FUNC == DEPTH_FUNC::GREATER)
+	{
+		return depth > dst_depth;
+	}
+	else if constexpr (FUNC == DEPTH_FUNC::NOT_EQUAL)
+	{
+		return depth != dst_depth;
+	}
+	else if constexpr (FUNC == DEPTH_FUNC::GREATER_EQUAL)
+	{
+		return depth >= dst_depth;
+	}
+	else
+	{
+		return true;
+	}
+}
+
+template<DEPTH_FUNC FUNC>
+inline int32_t CompareDepth(simd::Float depth, simd::Float dst_depth)
+{
+	if constexpr (FUNC == DEPTH_FUNC::NEVER)
+	{
+		return 0;
+	}
+	else if constexpr (FUNC == DEPTH_FUNC::LESS)
+	{
+		return simd::MoveMask(simd::CompareLess(depth, dst_depth));
+	}
+	else if constexpr (FUNC == DEPTH_FUNC::EQUAL)
+	{
+		return simd::MoveMask(simd::CompareEqual(depth, dst_depth));
+	}
+	else if constexpr (FUNC == DEPTH_FUNC::LESS_EQUAL)
+	{
+		return simd::MoveMask(simd::CompareLessEqual(depth, dst_depth));
+	}
+	else if constexpr (FUNC == DEPTH_FUNC::GREATER)
+	{
+		return simd::MoveMask(simd::CompareGreater(depth, dst_depth));
+	}
+	else if constexpr (FUNC == DEPTH_FUNC::NOT_EQUAL)
+	{
+		return simd::MoveMask(simd::CompareNotEqual(depth, dst_depth));
+	}
+	else if constexpr (FUNC == DEPTH_FUNC::GREATER_EQUAL)
+	{
+		return simd::MoveMask(simd::CompareGreaterEqual(depth, dst_depth));
+	}
+	else
+	{
+		return simd::ALL_LANES;
+	}
+}
+
+inline bool PassHiZ(const FrameBuffer& frame_buffer, const PipelineContext& context, const rasterizer::Triangle& triangle, int32_t tile_x, int32_t tile_y)
+{
+	if (!context.depth_test)
+	{
+		return true;
+	}
+
+	switch (context.depth_func)
+	{
+	case DEPTH_FUNC::NEVER:
+		return CompareHiZ<DEPTH_FUNC::NEVER>(frame_buffer, triangle, tile_x, tile_y);
+	case DEPTH_FUNC::LESS:
+		return CompareHiZ<DEPTH_FUNC::LESS>(frame_buffer, triangle, tile_x, tile_y);
+	case DEPTH_FUNC::LESS_EQUAL:
+		return CompareHiZ<DEPTH_FUNC::LESS_EQUAL>(frame_buffer, triangle, tile_x, tile_y);
+	default:
+		return true;
+	}
+}
+
+inline bool PassDepthTest(const PipelineContext& context, float depth, float dst_depth)
+{
+	if (!context.depth_test)
+	{
+		return true;
+	}
+
+	switch (context.depth_func)
+	{
+	case DEPTH_FUNC::NEVER:
+		return CompareDepth<DEPTH_FUNC::NEVER>(depth, dst_depth);
+	case DEPTH_FUNC::LESS:
+		return CompareDepth<DEPTH_FUNC::LESS>(depth, dst_depth);
+	case DEPTH_FUNC::EQUAL:
+		return CompareDepth<DEPTH_FUNC::EQUAL>(depth, dst_depth);
+	case DEPTH_FUNC::LESS_EQUAL:
+		return CompareDepth<DEPTH_FUNC::LESS_EQUAL>(depth, dst_depth);
+	case DEPTH_FUNC::GREATER:
+		return CompareDepth<DEPTH_FUNC::GREATER>(depth, dst_depth);
+	case DEPTH_FUNC::NOT_EQUAL:
+		return CompareDepth<DEPTH_FUNC::NOT_EQUAL>(depth, dst_depth);
+	case DEPTH_FUNC::GREATER_EQUAL:
+		return CompareDepth<DEPTH_FUNC::GREATER_EQUAL>(depth, dst_depth);
+	case DEPTH_FUNC::ALWAYS:
+		return CompareDepth<DEPTH_FUNC::ALWAYS>(depth, dst_depth);
+	}
+
+	return false;
+}
+
+inline int32_t PassDepthTest(const PipelineContext& context, simd::Float depth, simd::Float dst_depth)
+{
+	if (!context.depth_test)
+	{
+		return simd::ALL_LANES;
+	}
+
+	switch (context.depth_func)
+	{
+	case DEPTH_FUNC::NEVER:
+		return CompareDepth<DEPTH_FUNC::NEVER>(depth, dst_depth);
+	case DEPTH_FUNC::LESS:
+		return CompareDepth<DEPTH_FUNC::LESS>(depth, dst_depth);
+	case DEPTH_FUNC::EQUAL:
+		return CompareDepth<DEPTH_FUNC::EQUAL>(depth, dst_depth);
+	case DEPTH_FUNC::LESS_EQUAL:
+		return CompareDepth<DEPTH_FUNC::LESS_EQUAL>(depth, dst_depth);
+	case DEPTH_FUNC::GREATER:
+		return CompareDepth<DEPTH_FUNC::GREATER>(depth, dst_depth);
+	case DEPTH_FUNC::NOT_EQUAL:
+		return CompareDepth<DEPTH_FUNC::NOT_EQUAL>(depth, dst_depth);
+	case DEPTH_FUNC::GREATER_EQUAL:
+		return CompareDepth<DEPTH_FUNC::GREATER_EQUAL>(depth, dst_depth);
+	case DEPTH_FUNC::ALWAYS:
+		return CompareDepth<DEPTH_FUNC::ALWAYS>(depth, dst_depth);
+	}
+
+	return 0;
+}
+
+inline void SelectDepthWrite(const PipelineContext& context, bool& early_z, bool& late_z)
+{
+	// Depth is written before shading unless the pixel shader may still discard the fragment
+	const bool depth_write = context.depth_test && context.depth_write;
+	const bool can_discard = context.shader->CanDiscard();
+	early_z = depth_write && !can_discard;
+	late_z = depth_write && can_discard;
+}
+
+inline void WriteDepth(const FrameBuffer& frame_buffer, int32_t x, int32_t y, float depth)
+{
+	const int32_t num_tiles_x = (frame_buffer.width + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+	framebuffer::StoreDepth(frame_buffer, framebuffer::PixelOffset(frame_buffer, x, y), depth);
+	frame_buffer.hiz_dirty[(y / HIZ_TILE_SIZE) * num_tiles_x + x / HIZ_TILE_SIZE] = 1;
+}
+
+/* Early depth writes of one block row, collected per pixel and stored with one masked store per simd::WIDTH pixels */
+struct DepthRow
+{
+	alignas(32) float depths[BLOCK_SIZE];
+	uint32_t mask;
+};
+
+inline void WriteDepthRow(const FrameBuffer& frame_buffer, int32_t block_x, int32_t y, DepthRow& row)
+{
+	if (row.mask == 0)
+	{
+		return;
+	}
+
+	// Masked stores touch the whole row, which must not reach past the frame buffer or into pixels of another block
+	static_assert(BLOCK_SIZE % simd::WIDTH == 0, "a block row must be whole simd vectors");
+	const int32_t row_offset = framebuffer::PixelOffset(frame_buffer, block_x, y);
+	if (frame_buffer.tiled || block_x + BLOCK_SIZE <= frame_buffer.width)
+	{
+		for (int32_t i = 0; i < BLOCK_SIZE; i += simd::WIDTH)
+		{
+			const int32_t lanes = (row.mask >> i) & simd::ALL_LANES;
+			if (lanes)
+			{
+				framebuffer::StoreDepths(frame_buffer, row_offset + i, simd::Load(row.depths + i), lanes);
+			}
+		}
+	}
+	else
+	{
+		for (uint32_t mask = row.mask; mask; mask &= mask - 1)
+		{
+			const int32_t i = std::countr_zero(mask);
+			framebuffer::StoreDepth(frame_buffer, row_offset + i, row.depths[i]);
+		}
+	}
+
+	const int32_t num_tiles_x = (frame_buffer.width + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+	frame_buffer.hiz_dirty[(y / HIZ_TILE_SIZE) * num_tiles_x + block_x / HIZ_TILE_SIZE] = 1;
+	row.mask = 0;
+}
+
+inline void PrepareBlock(const FrameBuffer& frame_buffer, const PipelineContext& context, const rasterizer::Triangle& triangle, const BoundingBox& block, BLOCK_COVERAGE coverage, bool color_write)
+{
+	if (!frame_buffer.clear_state)
+	{
+		return;
+	}
+
+	const int32_t tile_x = block.min_x / FRAME_TILE_SIZE;
+	const int32_t tile_y = block.min_y / FRAME_TILE_SIZE;
+	const int32_t num_tiles_x = (frame_buffer.width + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE;
+	const uint8_t state = frame_buffer.clear_state[tile_y * num_tiles_x + tile_x];
+
+	// The depth test reads the cleared depth, but a pending clear of the plane the pass writes needs no fill
+	// if the triangle covers the whole tile opaquely and every pixel passes against the cleared depth,
+	// the geometry pass of deferred shaders writes the normals, its color clears are flushed before the pass
+	const uint8_t written_plane = frame_buffer.normal_buffer ? TILE_CLEAR_NORMAL : TILE_CLEAR_COLOR;
+	uint8_t overwritten_planes = 0;
+	const bool whole_tile = block.min_x == tile_x * FRAME_TILE_SIZE && block.min_y == tile_y * FRAME_TILE_SIZE &&
+		block.max_x == math::Min((tile_x + 1) * FRAME_TILE_SIZE, frame_buffer.width) &&
+		block.max_y == math::Min((tile_y + 1) * FRAME_TILE_SIZE, frame_buffer.height);
+	if ((state & written_plane) && color_write && !context.enable_blend && whole_tile && coverage == BLOCK_COVERAGE::INSIDE && !context.shader->CanDiscard())
+	{
+		// The margin absorbs the rounding of depth interpolated inside the triangle
+		constexpr float DEPTH_MARGIN = 1.0f / 65536.0f;
+		const bool monotonic_func = context.depth_func != DEPTH_FUNC::EQUAL && context.depth_func != DEPTH_FUNC::NOT_EQUAL;
+		const bool all_pass = !context.depth_test || ((state & TILE_CLEAR_DEPTH) && monotonic_func &&
+			PassDepthTest(context, triangle.min_depth - DEPTH_MARGIN, frame_buffer.clear_depth) &&
+			PassDepthTest(context, triangle.max_depth + DEPTH_MARGIN, frame_buffer.clear_depth));
+		if (all_pass)
+		{
+			overwritten_planes = written_plane;
+		}
+	}
+
+	framebuffer::TouchTile(frame_buffer, tile_x, tile_y, overwritten_planes);
+}
+
+/*
+ * Pipeline state as seen by the rasterizer kernels
+ * DynamicPipeline reads the state from the context, SpecializedPipeline fixes the shader type,
+ * blending and depth state at compile time, so its kernels carry no state branches and call
+ * the shader without virtual dispatch.
+ */
+struct DynamicPipeline
+{
+	static bool Blend(const PipelineContext& context)
+	{
+		return context.enable_blend;
+	}
+
+	static bool PassHiZ(const FrameBuffer& frame_buffer, const PipelineContext& context, const rasterizer::Triangle& triangle, int32_t tile_x, int32_t tile_y)
+	{
+		return ::PassHiZ(frame_buffer, context, triangle, tile_x, tile_y);
+	}
+
+	static bool PassDepthTest(const PipelineContext& context, float depth, float dst_depth)
+	{
+		return ::PassDepthTest(context, depth, dst_depth);
+	}
+
+	static int32_t PassDepthTest(const PipelineContext& context, simd::Float depth, simd::Float dst_depth)
+	{
+		return ::PassDepthTest(context, depth, dst_depth);
+	}
+
+	static void SelectDepthWrite(const PipelineContext& context, bool& early_z, bool& late_z)
+	{
+		::SelectDepthWrite(context, early_z, late_z);
+	}
+
+	static void ShadePixels(const PipelineContext& context, PixelBatch pixels, math::Vector4* colors, uint64_t& discard_mask)
+	{
+		pixels.varyings = reinterpret_cast<const float*>(context.shader_varyings);
+		pixels.varyings_ddx = reinterpret_cast<const float*>(context.shader_derivatives);
+		pixels.varyings_ddy = pixels.varyings_ddx ? pixels.varyings_ddx + (context.sizeof_varyings / sizeof(float)) * PIXEL_BATCH_SIZE : nullptr;
+		context.shader->ShadePixels(pixels, context.shader_constants, colors, discard_mask);
+	}
+};
+
+/* Disabled depth testing is expressed as DEPTH_FUNC::ALWAYS without depth writes */
+template<typename Shader, bool BLEND, DEPTH_FUNC FUNC, bool DEPTH_WRITE>
+struct SpecializedPipeline
+{
+	static constexpr bool Blend(const PipelineContext&)
+	{
+		return BLEND;
+	}
+
+	static bool PassHiZ(const FrameBuffer& frame_buffer, const PipelineContext&, const rasterizer::Triangle& triangle, int32_t tile_x, int32_t tile_y)
+	{
+		return CompareHiZ<FUNC>(frame_buffer, triangle, tile_x, tile_y);
+	}
+
+	static bool PassDepthTest(const PipelineContext&, float depth, float dst_depth)
+	{
+		return CompareDepth<FUNC>(depth, dst_depth);
+	}
+
+	static int32_t PassDepthTest(const PipelineContext&, simd::Float depth, simd::Float dst_depth)
+	{
+		return CompareDepth<FUNC>(depth, dst_depth);
+	}
+
+	static void SelectDepthWrite(const PipelineContext&, bool& early_z, bool& late_z)
+	{
+		early_z = DEPTH_WRITE && !Shader::CAN_DISCARD;
+		late_z = DEPTH_WRITE && Shader::CAN_DISCARD;
+	}
+
+	static void ShadePixels(const PipelineContext& context, PixelBatch pixels, math::Vector4* colors, uint64_t& discard_mask)
+	{
+		pixels.varyings = reinterpret_cast<const float*>(context.shader_varyings);
+		pixels.varyings_ddx = reinterpret_cast<const float*>(context.shader_derivatives);
+		pixels.varyings_ddy = pixels.varyings_ddx ? pixels.varyings_ddx + (sizeof(typename Shader::Varyings) / sizeof(float)) * PIXEL_BATCH_SIZE : nullptr;
+		Shader::ShadeBatch(pixels, context.shader_constants, colors, discard_mask);
+	}
+};
+
+struct FragmentBatch
+{
+	int32_t count;
+	int32_t x[PIXEL_BATCH_SIZE];
+	int32_t y[PIXEL_BATCH_SIZE];
+	float depths[PIXEL_BATCH_SIZE];
+	alignas(32) float sample_x[PIXEL_BATCH_SIZE];
+	alignas(32) float sample_y[PIXEL_BATCH_SIZE];
+	alignas(32) float w[PIXEL_BATCH_SIZE];
+};
+
+inline int32_t AppendFragment(FragmentBatch& batch, int32_t x, int32_t y, float depth)
+{
+	SR_ASSERT(batch.count < PIXEL_BATCH_SIZE);
+	const int32_t slot = batch.count++;
+	batch.x[slot] = x;
+	batch.y[slot] = y;
+	batch.depths[slot] = depth;
+	batch.sample_x[slot] = static_cast<float>(x) + 0.5f;
+	batch.sample_y[slot] = static_cast<float>(y) + 0.5f;
+	return slot;
+}
+
+inline float EvaluatePlane(const rasterizer::InterpolationPlane& plane, float sample_x, float sample_y)
+{
+	return plane.origin + plane.step_x * sample_x + plane.step_y * sample_y;
+}
+
+inline simd::Float EvaluatePlane(const rasterizer::InterpolationPlane& plane, simd::Float sample_x, simd::Float sample_y)
+{
+	return simd::Add(simd::Set(plane.origin), simd::Add(simd::Mul(simd::Set(plane.step_x), sample_x), simd::Mul(simd::Set(plane.step_y), sample_y)));
+}
+
+inline void InterpolateFragments(FragmentBatch& batch, const rasterizer::Triangle& triangle, const PipelineContext& context)
+{
+	// Pad the last SIMD group with a covered sample, so no lane divides by zero
+	const int32_t num_padded = (batch.count + simd::WIDTH - 1) & ~(simd::WIDTH - 1);
+	for (int32_t i = batch.count; i < num_padded; ++i)
+	{
+		batch.sample_x[i] = batch.sample_x[0];
+		batch.sample_y[i] = batch.sample_y[0];
+	}
+
+	// Perspective correction, one reciprocal per pixel recovers w from the interpolated 1 / w
+	const simd::Float one = simd::Set(1.0f);
+	for (int32_t i = 0; i < num_padded; i += simd::WIDTH)
+	{
+		const simd::Float inv_w = EvaluatePlane(triangle.inv_w_plane, simd::Load(batch.sample_x + i), simd::Load(batch.sample_y + i));
+		simd::Store(batch.w + i, simd::Div(one, inv_w));
+	}
+
+	// One declared component of every pixel at a time, which is exactly the layout ShadePixels reads
+	float* dst = reinterpret_cast<float*>(context.shader_varyings);
+	for (int32_t plane = 0; plane < triangle.num_planes; ++plane)
+	{
+		const rasterizer::InterpolationPlane& component_plane = triangle.planes[plane];
+		float* dst_component = dst + triangle.plane_components[plane] * PIXEL_BATCH_SIZE;
+		for (int32_t i = 0; i < num_padded; i += simd::WIDTH)
+		{
+			const simd::Float value = EvaluatePlane(component_plane, simd::Load(batch.sample_x + i), simd::Load(batch.sample_y + i));
+			simd::Store(dst_component + i, simd::Mul(value, simd::Load(batch.w + i)));
+		}
+	}
+}
+
+inline void InterpolateDerivatives(const FragmentBatch& batch, const rasterizer::Triangle& triangle, const PipelineContext& context)
+{
+	if (triangle.derivative_planes == 0)
+	{
+		return;
+	}
+
+	SR_ASSERT(context.shader_derivatives);
+
+	// Coarse derivatives, all pixels of a 2x2 quad share the differences taken at its top-left pixel
+	// The planes extend past the triangle edges, so partially covered quads need no helper pixels
+	alignas(32) float quad_x[PIXEL_BATCH_SIZE];
+	alignas(32) float quad_y[PIXEL_BATCH_SIZE];
+	alignas(32) float quad_w[3][PIXEL_BATCH_SIZE];
+	const int32_t num_padded = (batch.count + simd::WIDTH - 1) & ~(simd::WIDTH - 1);
+	for (int32_t i = 0; i < num_padded; ++i)
+	{
+		const int32_t slot = i < batch.count ? i : 0;
+		quad_x[i] = static_cast<float>(batch.x[slot] & ~1) + 0.5f;
+		quad_y[i] = static_cast<float>(batch.y[slot] & ~1) + 0.5f;
+	}
+
+	const simd::Float one = simd::Set(1.0f);
+	for (int32_t i = 0; i < num_padded; i += simd::WIDTH)
+	{
+		const simd::Float sample_x = simd::Load(quad_x + i);
+		const simd::Float sample_y = simd::Load(quad_y + i);
+		simd::Store(quad_w[0] + i, simd::Div(one, EvaluatePlane(triangle.inv_w_plane, sample_x, sample_y)));
+		simd::Store(quad_w[1] + i, simd::Div(one, EvaluatePlane(triangle.inv_w_plane, simd::Add(sample_x, one), sample_y)));
+		simd::Store(quad_w[2] + i, simd::Div(one, EvaluatePlane(triangle.inv_w_plane, sample_x, simd::Add(sample_y, one))));
+	}
+
+	float* dst_ddx = reinterpret_cast<float*>(context.shader_derivatives);
+	float* dst_ddy = dst_ddx + (context.sizeof_varyings / sizeof(float)) * PIXEL_BATCH_SIZE;
+	for (int32_t plane = 0; plane < triangle.num_planes; ++plane)
+	{
+		if (!(triangle.derivative_planes & (1u << plane)))
+		{
+			continue;
+		}
+
+		const rasterizer::InterpolationPlane& component_plane = triangle.planes[plane];
+		const int32_t component_offset = triangle.plane_components[plane] * PIXEL_BATCH_SIZE;
+		for (int32_t i = 0; i < num_padded; i += simd::WIDTH)
+		{
+			const simd::Float sample_x = simd::Load(quad_x + i);
+			const simd::Float sample_y = simd::Load(quad_y + i);
+			const simd::Float value = simd::Mul(EvaluatePlane(component_plane, sample_x, sample_y), simd::Load(quad_w[0] + i));
+			const simd::Float value_x = simd::Mul(EvaluatePlane(component_plane, simd::Add(sample_x, one), sample_y), simd::Load(quad_w[1] + i));
+			const simd::Float value_y = simd::Mul(EvaluatePlane(component_plane, sample_x, simd::Add(sample_y, one)), simd::Load(quad_w[2] + i));
+			simd::Store(dst_ddx + component_offset + i, simd::Sub(value_x, value));
+			simd::Store(dst_ddy + component_offset + i, simd::Sub(value_y, value));
+		}
+	}
+}
+
+template<typename Pipeline>
+inline void MergeFragments(const FrameBuffer& frame_buffer, const PipelineContext& context, const int32_t* offsets, int32_t count, math::Vector4* colors)
+{
+	const bool blend = Pipeline::Blend(context);
+	const bool unorm = framebuffer::IsUnormFormat(frame_buffer.color_format);
+
+	// Float targets keep colors outside [0, 1], only the blend factor is clamped, unorm targets clamp when packing unless blending needs it first
+	if (blend || !unorm)
+	{
+		for (int32_t i = 0; i < count; ++i)
+		{
+			if (unorm)
+			{
+				colors[i] = math::Vector4Saturate(colors[i]);
+			}
+			else
+			{
+				colors[i].w = math::FloatSaturate(colors[i].w);
+			}
+		}
+	}
+
+	// Perform blending
+	// Alpha is written like the color channels, the pixel shader alpha without blending and blended with the same factors otherwise
+	if (blend)
+	{
+		// out_color = src_color * src_alpha + dst_color * (1 - src_alpha), alpha included
+		alignas(16) math::Vector4 dst_colors[PIXEL_BATCH_SIZE];
+		framebuffer::LoadColors(frame_buffer, offsets, count, dst_colors);
+		for (int32_t i = 0; i < count; ++i)
+		{
+			math::Vector4& color = colors[i];
+			const math::Vector4& dst_color = dst_colors[i];
+			color.x = color.x * color.w + dst_color.x * (1.0f - color.w);
+			color.y = color.y * color.w + dst_color.y * (1.0f - color.w);
+			color.z = color.z * color.w + dst_color.z * (1.0f - color.w);
+			color.w = color.w * color.w + dst_color.w * (1.0f - color.w);
+		}
+	}
+
+	// Output merge, packed into the format of the target once for the whole batch
+	framebuffer::StoreColors(frame_buffer, offsets, count, colors);
+}
+
+inline void WriteNormal(const FrameBuffer& frame_buffer, int32_t index, const math::Vector4& normal)
+{
+	// A packed normal is never 0, so the write also marks the pixel as covered for the lighting pass
+	frame_buffer.normal_buffer[index] = framebuffer::PackNormal(math::Vector3(normal.x, normal.y, normal.z));
+}
+
+template<typename Pipeline>
+inline void ShadeFragments(const FrameBuffer& frame_buffer, PipelineContext& context, FragmentBatch& batch, const rasterizer::Triangle& triangle, bool late_z)
+{
+	if (batch.count == 0)
+	{
+		return;
+	}
+
+	InterpolateDerivatives(batch, triangle, context);
+
+	// Execute pixel shader, once for the whole batch, the second half holds the normals of deferred shaders
+	alignas(16) math::Vector4 colors[PIXEL_BATCH_SIZE * 2];
+	uint64_t discard_mask = 0;
+	PixelBatch pixels;
+	pixels.count = batch.count;
+	pixels.x = batch.x;
+	pixels.y = batch.y;
+	pixels.front_facing = triangle.front_facing;
+	Pipeline::ShadePixels(context, pixels, colors, discard_mask);
+
+	// Surviving fragments are compacted to the front of colors, the normals behind them are read before any is overwritten
+	int32_t offsets[PIXEL_BATCH_SIZE];
+	int32_t count = 0;
+	for (int32_t i = 0; i < batch.count; ++i)
+	{
+		if (discard_mask & (1ull << i))
+		{
+			continue;
+		}
+
+		if (late_z)
+		{
+			WriteDepth(frame_buffer, batch.x[i], batch.y[i], batch.depths[i]);
+		}
+
+		offsets[count] = framebuffer::PixelOffset(frame_buffer, batch.x[i], batch.y[i]);
+		colors[count] = colors[i];
+		if (frame_buffer.normal_buffer)
+		{
+			WriteNormal(frame_buffer, offsets[count], colors[PIXEL_BATCH_SIZE + i]);
+		}
+		++count;
+	}
+
+	MergeFragments<Pipeline>(frame_buffer, context, offsets, count, colors);
+
+	batch.count = 0;
+}
+
+template<typename Pipeline>
+inline void RasterizeKernel_V1(const FrameBuffer& frame_buffer, PipelineContext& context, const rasterizer::Triangle& triangle, const BoundingBox& clip_rect)
+{
+	bool early_z, late_z;
+	Pipeline::SelectDepthWrite(context, early_z, late_z);
+
+	FragmentBatch batch;
+	batch.count = 0;
+
+	float* dst = reinterpret_cast<float*>(context.shader_varyings);
+	float values[MAX_VARYING_COMPONENTS];
+
+	Trapezoid trapezoids[2];
+	const int32_t num_triangles = MakeTrapezoid_V1(trapezoids, triangle.screen_coords);
+
+	for (int32_t i = 0; i < num_triangles; ++i)
+	{
+		const Trapezoid& trapezoid = trapezoids[i];
+
+		const int32_t min_y = math::Max(math::FloorToInt(trapezoid.top + 0.5f), clip_rect.min_y);
+		const int32_t max_y = math::Min(math::CeilToInt(trapezoid.bottom - 0.5f), clip_rect.max_y);
+
+		// Inverse slopes of both edges, x is evaluated from the upper end of the edge on every scanline
+		// instead of accumulated, so the neighbour sharing the edge finds exactly the same span ends
+		const float slope1 = (trapezoid.left.screen_coord2.x - trapezoid.left.screen_coord1.x) / (trapezoid.left.screen_coord2.y - trapezoid.left.screen_coord1.y);
+		const float slope2 = (trapezoid.right.screen_coord2.x - trapezoid.right.screen_coord1.x) / (trapezoid.right.screen_coord2.y - trapezoid.right.screen_coord1.y);
+		for (int32_t y = min_y; y < max_y; ++y)
+		{
+			const float fy = static_cast<float>(y) + 0.5f;
+			const float fx1 = trapezoid.left.screen_coord1.x + (fy - trapezoid.left.screen_coord1.y) * slope1;
+			const float fx2 = trapezoid.right.screen_coord1.x + (fy - trapezoid.right.screen_coord1.y) * slope2;
+			const int32_t min_x = math::Max(math::FloorToInt(fx1 + 0.5f), clip_rect.min_x);
+			const int32_t max_x = math::Min(math::CeilToInt(fx2 - 0.5f), clip_rect.max_x);
+			if (min_x >= max_x)
+			{
+				continue;
+			}
+
+			for (int32_t x = min_x; x < max_x;)
+			{
+				// Depth, 1 / w and every component divided by w are sampled at the start of an aligned block row
+				// and stepped by adds inside it, so the values do not depend on where a tile clips the span
+				const int32_t block_x = x & ~(BLOCK_SIZE - 1);
+				const int32_t row_offset = framebuffer::RowOffset(frame_buffer, block_x, y);
+				framebuffer::TouchTile(frame_buffer, block_x / FRAME_TILE_SIZE, y / FRAME_TILE_SIZE, 0);
+				const int32_t block_end = math::Min(block_x + BLOCK_SIZE, max_x);
+				const float fx = static_cast<float>(block_x) + 0.5f;
+				float depth = EvaluatePlane(triangle.depth_plane, fx, fy);
+				float inv_w = EvaluatePlane(triangle.inv_w_plane, fx, fy);
+				for (int32_t plane = 0; plane < triangle.num_planes; ++plane)
+				{
+					values[plane] = EvaluatePlane(triangle.planes[plane], fx, fy);
+				}
+
+				for (int32_t step_x = block_x; step_x < block_end; ++step_x)
+				{
+					// Depth test
+					if (step_x >= x && Pipeline::PassDepthTest(context, framebuffer::QuantizeDepth(frame_buffer, depth), framebuffer::LoadDepth(frame_buffer, row_offset + step_x)))
+					{
+						if (early_z)
+						{
+							WriteDepth(frame_buffer, step_x, y, depth);
+						}
+
+						// V1 interpolates its varyings straight into the batch
+						if (batch.count == PIXEL_BATCH_SIZE)
+						{
+							ShadeFragments<Pipeline>(frame_buffer, context, batch, triangle, late_z);
+						}
+
+						// Perspective correction, one reciprocal per pixel
+						const int32_t slot = AppendFragment(batch, step_x, y, depth);
+						const float w = 1.0f / inv_w;
+						for (int32_t plane = 0; plane < triangle.num_planes; ++plane)
+						{
+							dst[triangle.plane_components[plane] * PIXEL_BATCH_SIZE + slot] = values[plane] * w;
+						}
+					}
+
+					depth += triangle.depth_plane.step_x;
+					inv_w += triangle.inv_w_plane.step_x;
+					for (int32_t plane = 0; plane < triangle.num_planes; ++plane)
+					{
+						values[plane] += triangle.planes[plane].step_x;
+					}
+				}
+
+				x = block_end;
+			}
+		}
+	}
+
+	ShadeFragments<Pipeline>(frame_buffer, context, batch, triangle, late_z);
+}
+
+template<typename Pipeline>
+inline void RasterizeKernel_V2(const FrameBuffer& frame_buffer, PipelineContext& context, const rasterizer::Triangle& triangle, const BoundingBox& clip_rect)
+{
+	const int32_t min_x = math::Max(triangle.bounding_box.min_x, clip_rect.min_x);
+	const int32_t min_y = math::Max(triangle.bounding_box.min_y, clip_rect.min_y);
+	const int32_t max_x = math::Min(triangle.bounding_box.max_x, clip_rect.max_x);
+	const int32_t max_y = math::Min(triangle.bounding_box.max_y, clip_rect.max_y);
+
+	bool early_z, late_z;
+	Pipeline::SelectDepthWrite(context, early_z, late_z);
+
+	// Barycentric weights are linear in the sample point, s = s_dx * x + s_dy * y + s_0
+	const BarycentricPlanes_V2 planes = MakeBarycentricPlanes_V2(triangle.screen_coords);
+
+	const simd::Float zero = simd::Set(0.0f);
+	const simd::Float one = simd::Set(1.0f);
+	const simd::Float lane_offsets = simd::LaneOffsets();
+	const simd::Float s_dx = simd::Set(planes.s_dx);
+	const simd::Float t_dx = simd::Set(planes.t_dx);
+	const simd::Float depth0 = simd::Set(triangle.screen_depth[0]);
+	const simd::Float depth1 = simd::Set(triangle.screen_depth[1] - triangle.screen_depth[0]);
+	const simd::Float depth2 = simd::Set(triangle.screen_depth[2] - triangle.screen_depth[0]);
+
+	alignas(32) float lane_depths[simd::WIDTH];
+
+	FragmentBatch batch;
+	batch.count = 0;
+	DepthRow depth_row;
+	depth_row.mask = 0;
+
+	// Visit screen-aligned blocks in row-major order, so every block stays within a few cache lines of each buffer
+	for (int32_t block_y = min_y & ~(BLOCK_SIZE - 1); block_y < max_y; block_y += BLOCK_SIZE)
+	{
+		for (int32_t block_x = min_x & ~(BLOCK_SIZE - 1); block_x < max_x; block_x += BLOCK_SIZE)
+		{
+			BoundingBox block;
+			block.min_x = math::Max(block_x, min_x);
+			block.min_y = math::Max(block_y, min_y);
+			block.max_x = math::Min(block_x + BLOCK_SIZE, max_x);
+			block.max_y = math::Min(block_y + BLOCK_SIZE, max_y);
+
+			// Hierarchical depth test, the nearest point of the triangle loses against every pixel of the block
+			if (!Pipeline::PassHiZ(frame_buffer, context, triangle, block_x / HIZ_TILE_SIZE, block_y / HIZ_TILE_SIZE))
+			{
+				continue;
+			}
+
+			const BLOCK_COVERAGE coverage = ClassifyBlock_V2(planes, block);
+			if (coverage == BLOCK_COVERAGE::OUTSIDE)
+			{
+				continue;
+			}
+
+			PrepareBlock(frame_buffer, context, triangle, block, coverage, true);
+
+			for (int32_t y = block.min_y; y < block.max_y; ++y)
+			{
+				const float py = static_cast<float>(y) + 0.5f;
+				const float row_s = planes.s_0 + planes.s_dy * py;
+				const float row_t = planes.t_0 + planes.t_dy * py;
+				const int32_t row_offset = framebuffer::RowOffset(frame_buffer, block_x, y);
+
+				for (int32_t x = block.min_x; x < block.max_x; x += simd::WIDTH)
+				{
+					const int32_t num_lanes = math::Min(block.max_x - x, simd::WIDTH);
+					const simd::Float px = simd::Add(simd::Set(static_cast<float>(x) + 0.5f), lane_offsets);
+					const simd::Float s = simd::Add(simd::Set(row_s), simd::Mul(s_dx, px));
+					const simd::Float t = simd::Add(simd::Set(row_t), simd::Mul(t_dx, px));
+
+					// Depth interpolation and depth test
+					const simd::Float depth = simd::Add(depth0, simd::Add(simd::Mul(depth1, s), simd::Mul(depth2, t)));
+					const simd::Float test_depth = framebuffer::QuantizeDepth(frame_buffer, depth);
+					int32_t lanes = (1 << num_lanes) - 1;
+					if (num_lanes == simd::WIDTH)
+					{
+						lanes &= Pipeline::PassDepthTest(context, test_depth, framebuffer::LoadDepths(frame_buffer, row_offset + x));
+					}
+					else
+					{
+						// Do not read past the end of the block, the missing lanes are masked out above
+						for (int32_t lane = 0; lane < num_lanes; ++lane)
+						{
+							lane_depths[lane] = framebuffer::LoadDepth(frame_buffer, row_offset + x + lane);
+						}
+						std::fill(lane_depths + num_lanes, lane_depths + simd::WIDTH, 0.0f);
+						lanes &= Pipeline::PassDepthTest(context, test_depth, simd::Load(lane_depths));
+					}
+
+					// Coverage, blocks fully inside the triangle skip it
+					if (coverage == BLOCK_COVERAGE::PARTIAL)
+					{
+						const simd::Float r = simd::Sub(simd::Sub(one, s), t);
+						lanes &= simd::MoveMask(simd::And(simd::And(simd::CompareGreater(s, zero), simd::CompareGreater(t, zero)), simd::CompareGreater(r, zero)));
+					}
+
+					if (lanes == 0)
+					{
+						continue;
+					}
+
+					// Only the surviving pixels are collected for interpolation and shading
+					simd::Store(lane_depths, depth);
+					while (lanes)
+					{
+						const int32_t lane = std::countr_zero(static_cast<uint32_t>(lanes));
+						lanes &= lanes - 1;
+
+						if (early_z)
+						{
+							depth_row.depths[x + lane - block_x] = lane_depths[lane];
+							depth_row.mask |= 1u << (x + lane - block_x);
+						}
+
+						AppendFragment(batch, x + lane, y, lane_depths[lane]);
+					}
+				}
+
+				WriteDepthRow(frame_buffer, block_x, y, depth_row);
+			}
+
+			// A block holds at most PIXEL_BATCH_SIZE pixels, so it is shaded with a single call
+			if (batch.count > 0)
+			{
+				InterpolateFragments(batch, triangle, context);
+				ShadeFragments<Pipeline>(frame_buffer, context, batch, triangle, late_z);
+			}
+		}
+	}
+}
+
+template<typename Pipeline>
+inline void RasterizeKernel_V3(const FrameBuffer& frame_buffer, PipelineContext& context, const rasterizer::Triangle& triangle, const BoundingBox& clip_rect)
+{
+	const int32_t min_x = math::Max(triangle.bounding_box.min_x, clip_rect.min_x);
+	const int32_t min_y = math::Max(triangle.bounding_box.min_y, clip_rect.min_y);
+	const int32_t max_x = math::Min(triangle.bounding_box.max_x, clip_rect.max_x);
+	const int32_t max_y = math::Min(triangle.bounding_box.max_y, clip_rect.max_y);
+
+	const rasterizer::EdgeFunction* edges = triangle.edges;
+
+	bool early_z, late_z;
+	Pipeline::SelectDepthWrite(context, early_z, late_z);
+
+	FragmentBatch batch;
+	batch.count = 0;
+	DepthRow depth_row;
+	depth_row.mask = 0;
+
+	// Same block traversal as V2, with exact integer coverage
+	for (int32_t block_y = min_y & ~(BLOCK_SIZE - 1); block_y < max_y; block_y += BLOCK_SIZE)
+	{
+		for (int32_t block_x = min_x & ~(BLOCK_SIZE - 1); block_x < max_x; block_x += BLOCK_SIZE)
+		{
+			BoundingBox block;
+			block.min_x = math::Max(block_x, min_x);
+			block.min_y = math::Max(block_y, min_y);
+			block.max_x = math::Min(block_x + BLOCK_SIZE, max_x);
+			block.max_y = math::Min(block_y + BLOCK_SIZE, max_y);
+
+			// Hierarchical depth test, the nearest point of the triangle loses against every pixel of the block
+			if (!Pipeline::PassHiZ(frame_buffer, context, triangle, block_x / HIZ_TILE_SIZE, block_y / HIZ_TILE_SIZE))
+			{
+				continue;
+			}
+
+			const BLOCK_COVERAGE coverage = ClassifyBlock_V3(edges, block);
+			if (coverage == BLOCK_COVERAGE::OUTSIDE)
+			{
+				continue;
+			}
+
+			PrepareBlock(frame_buffer, context, triangle, block, coverage, true);
+
+			for (int32_t y = block.min_y; y < block.max_y; ++y)
+			{
+				int64_t e0 = edges[0].origin + edges[0].step_x * block.min_x + edges[0].step_y * y;
+				int64_t e1 = edges[1].origin + edges[1].step_x * block.min_x + edges[1].step_y * y;
+				int64_t e2 = edges[2].origin + edges[2].step_x * block.min_x + edges[2].step_y * y;
+
+				for (int32_t x = block.min_x; x < block.max_x; ++x)
+				{
+					// Coverage, blocks fully inside the triangle skip it
+					if (coverage == BLOCK_COVERAGE::INSIDE || (e0 | e1 | e2) >= 0)
+					{
+						const math::Vector3 weights = math::Vector3(
+							static_cast<float>(e0 - edges[0].bias) * triangle.inv_area,
+							static_cast<float>(e1 - edges[1].bias) * triangle.inv_area,
+							static_cast<float>(e2 - edges[2].bias) * triangle.inv_area);
+
+						const int32_t index = framebuffer::PixelOffset(frame_buffer, x, y);
+						const float depth = InterpolateDepth_V2(triangle.screen_depth, weights);
+						// Depth test
+						if (Pipeline::PassDepthTest(context, framebuffer::QuantizeDepth(frame_buffer, depth), framebuffer::LoadDepth(frame_buffer, index)))
+						{
+							if (early_z)
+							{
+								depth_row.depths[x - block_x] = depth;
+								depth_row.mask |= 1u << (x - block_x);
+							}
+
+							AppendFragment(batch, x, y, depth);
+						}
+					}
+
+					e0 += edges[0].step_x;
+					e1 += edges[1].step_x;
+					e2 += edges[2].step_x;
+				}
+
+				WriteDepthRow(frame_buffer, block_x, y, depth_row);
+			}
+
+			// A block holds at most PIXEL_BATCH_SIZE pixels, so it is shaded with a single call
+			if (batch.count > 0)
+			{
+				InterpolateFragments(batch, triangle, context);
+				ShadeFragments<Pipeline>(frame_buffer, context, batch, triangle, late_z);
+			}
+		}
+	}
+}
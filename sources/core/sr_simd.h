@@ -0,0 +1,335 @@
+#pragma once
+
+/*
+ * Thin wrapper over the widest float vector the target supports
+ * AVX2 builds process 8 lanes, everything else falls back to 4 SSE lanes.
+ */
+namespace simd
+{
+#if defined(__AVX2__)
+	constexpr int32_t WIDTH = 8;
+	using Float = __m256;
+#else
+	constexpr int32_t WIDTH = 4;
+	using Float = __m128;
+#endif
+
+	constexpr int32_t ALL_LANES = (1 << WIDTH) - 1;
+
+	inline Float Set(float value);
+	inline Float LaneOffsets();
+	inline Float Load(const float* src);
+	inline Float LoadUInt16(const uint16_t* src);
+	inline Float LoadUInt24(const uint32_t* src);
+	inline void Store(float* dst, Float value);
+
+	// Masked stores, only lanes with their bit set in lanes are written, the integer stores take whole numbers in range
+	inline void Store(float* dst, Float value, int32_t lanes);
+	inline void StoreUInt16(uint16_t* dst, Float value, int32_t lanes);
+	inline void StoreUInt32(uint32_t* dst, Float value, int32_t lanes);
+
+	inline Float Add(Float a, Float b);
+	inline Float Sub(Float a, Float b);
+	inline Float Mul(Float a, Float b);
+	inline Float Div(Float a, Float b);
+	inline Float Min(Float a, Float b);
+	inline Float Max(Float a, Float b);
+	inline Float Truncate(Float a);
+	inline Float And(Float a, Float b);
+	inline Float CompareLess(Float a, Float b);
+	inline Float CompareLessEqual(Float a, Float b);
+	inline Float CompareGreater(Float a, Float b);
+	inline Float CompareGreaterEqual(Float a, Float b);
+	inline Float CompareEqual(Float a, Float b);
+	inline Float CompareNotEqual(Float a, Float b);
+	inline int32_t MoveMask(Float mask);
+}
+
+#if defined(__AVX2__)
+
+simd::Float simd::Set(float value)
+{
+	return _mm256_set1_ps(value);
+}
+
+simd::Float simd::LaneOffsets()
+{
+	return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+}
+
+simd::Float simd::Load(const float* src)
+{
+	return _mm256_loadu_ps(src);
+}
+
+simd::Float simd::LoadUInt16(const uint16_t* src)
+{
+	return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))));
+}
+
+simd::Float simd::LoadUInt24(const uint32_t* src)
+{
+	const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+	return _mm256_cvtepi32_ps(_mm256_and_si256(values, _mm256_set1_epi32(0xffffff)));
+}
+
+void simd::Store(float* dst, Float value)
+{
+	_mm256_storeu_ps(dst, value);
+}
+
+namespace simd
+{
+	// All bits of 32-bit lane i set if bit i of lanes is set
+	inline __m256i LaneMask(int32_t lanes)
+	{
+		const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+		return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(lanes), bits), bits);
+	}
+}
+
+void simd::Store(float* dst, Float value, int32_t lanes)
+{
+	_mm256_maskstore_ps(dst, LaneMask(lanes), value);
+}
+
+void simd::StoreUInt16(uint16_t* dst, Float value, int32_t lanes)
+{
+	// There is no masked 16-bit store, the unselected lanes are written back unchanged
+	const __m256i values = _mm256_cvttps_epi32(value);
+	const __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1));
+	const __m256i mask = LaneMask(lanes);
+	const __m128i packed_mask = _mm_packs_epi32(_mm256_castsi256_si128(mask), _mm256_extracti128_si256(mask, 1));
+	const __m128i old_values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_blendv_epi8(old_values, packed, packed_mask));
+}
+
+void simd::StoreUInt32(uint32_t* dst, Float value, int32_t lanes)
+{
+	_mm256_maskstore_epi32(reinterpret_cast<int32_t*>(dst), LaneMask(lanes), _mm256_cvttps_epi32(value));
+}
+
+simd::Float simd::Add(Float a, Float b)
+{
+	return _mm256_add_ps(a, b);
+}
+
+simd::Float simd::Sub(Float a, Float b)
+{
+	return _mm256_sub_ps(a, b);
+}
+
+simd::Float simd::Mul(Float a, Float b)
+{
+	return _mm256_mul_ps(a, b);
+}
+
+simd::Float simd::Div(Float a, Float b)
+{
+	return _mm256_div_ps(a, b);
+}
+
+simd::Float simd::Min(Float a, Float b)
+{
+	return _mm256_min_ps(a, b);
+}
+
+simd::Float simd::Max(Float a, Float b)
+{
+	return _mm256_max_ps(a, b);
+}
+
+simd::Float simd::Truncate(Float a)
+{
+	return _mm256_cvtepi32_ps(_mm256_cvttps_epi32(a));
+}
+
+simd::Float simd::And(Float a, Float b)
+{
+	return _mm256_and_ps(a, b);
+}
+
+simd::Float simd::CompareLess(Float a, Float b)
+{
+	return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+}
+
+simd::Float simd::CompareLessEqual(Float a, Float b)
+{
+	return _mm256_cmp_ps(a, b, _CMP_LE_OQ);
+}
+
+simd::Float simd::CompareGreater(Float a, Float b)
+{
+	return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+}
+
+simd::Float simd::CompareGreaterEqual(Float a, Float b)
+{
+	return _mm256_cmp_ps(a, b, _CMP_GE_OQ);
+}
+
+simd::Float simd::CompareEqual(Float a, Float b)
+{
+	return _mm256_cmp_ps(a, b, _CMP_EQ_OQ);
+}
+
+simd::Float simd::CompareNotEqual(Float a, Float b)
+{
+	return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ);
+}
+
+int32_t simd::MoveMask(Float mask)
+{
+	return _mm256_movemask_ps(mask);
+}
+
+#else
+
+simd::Float simd::Set(float value)
+{
+	return _mm_set1_ps(value);
+}
+
+simd::Float simd::LaneOffsets()
+{
+	return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+}
+
+simd::Float simd::Load(const float* src)
+{
+	return _mm_loadu_ps(src);
+}
+
+simd::Float simd::LoadUInt16(const uint16_t* src)
+{
+	const __m128i values = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(values, _mm_setzero_si128()));
+}
+
+simd::Float simd::LoadUInt24(const uint32_t* src)
+{
+	const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+	return _mm_cvtepi32_ps(_mm_and_si128(values, _mm_set1_epi32(0xffffff)));
+}
+
+void simd::Store(float* dst, Float value)
+{
+	_mm_storeu_ps(dst, value);
+}
+
+void simd::Store(float* dst, Float value, int32_t lanes)
+{
+	alignas(16) float values[WIDTH];
+	_mm_store_ps(values, value);
+	for (int32_t lane = 0; lane < WIDTH; ++lane)
+	{
+		if (lanes & (1 << lane))
+		{
+			dst[lane] = values[lane];
+		}
+	}
+}
+
+void simd::StoreUInt16(uint16_t* dst, Float value, int32_t lanes)
+{
+	alignas(16) int32_t values[WIDTH];
+	_mm_store_si128(reinterpret_cast<__m128i*>(values), _mm_cvttps_epi32(value));
+	for (int32_t lane = 0; lane < WIDTH; ++lane)
+	{
+		if (lanes & (1 << lane))
+		{
+			dst[lane] = static_cast<uint16_t>(values[lane]);
+		}
+	}
+}
+
+void simd::StoreUInt32(uint32_t* dst, Float value, int32_t lanes)
+{
+	alignas(16) int32_t values[WIDTH];
+	_mm_store_si128(reinterpret_cast<__m128i*>(values), _mm_cvttps_epi32(value));
+	for (int32_t lane = 0; lane < WIDTH; ++lane)
+	{
+		if (lanes & (1 << lane))
+		{
+			dst[lane] = static_cast<uint32_t>(values[lane]);
+		}
+	}
+}
+
+simd::Float simd::Add(Float a, Float b)
+{
+	return _mm_add_ps(a, b);
+}
+
+simd::Float simd::Sub(Float a, Float b)
+{
+	return _mm_sub_ps(a, b);
+}
+
+simd::Float simd::Mul(Float a, Float b)
+{
+	return _mm_mul_ps(a, b);
+}
+
+simd::Float simd::Div(Float a, Float b)
+{
+	return _mm_div_ps(a, b);
+}
+
+simd::Float simd::Min(Float a, Float b)
+{
+	return _mm_min_ps(a, b);
+}
+
+simd::Float simd::Max(Float a, Float b)
+{
+	return _mm_max_ps(a, b);
+}
+
+simd::Float simd::Truncate(Float a)
+{
+	return _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+}
+
+simd::Float simd::And(Float a, Float b)
+{
+	return _mm_and_ps(a, b);
+}
+
+simd::Float simd::CompareLess(Float a, Float b)
+{
+	return _mm_cmplt_ps(a, b);
+}
+
+simd::Float simd::CompareLessEqual(Float a, Float b)
+{
+	return _mm_cmple_ps(a, b);
+}
+
+simd::Float simd::CompareGreater(Float a, Float b)
+{
+	return _mm_cmpgt_ps(a, b);
+}
+
+simd::Float simd::CompareGreaterEqual(Float a, Float b)
+{
+	return _mm_cmpge_ps(a, b);
+}
+
+simd::Float simd::CompareEqual(Float a, Float b)
+{
+	return _mm_cmpeq_ps(a, b);
+}
+
+simd::Float simd::CompareNotEqual(Float a, Float b)
+{
+	return _mm_cmpneq_ps(a, b);
+}
+
+int32_t simd::MoveMask(Float mask)
+{
+	return _mm_movemask_ps(mask);
+}
+
+#endif
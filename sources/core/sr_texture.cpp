@@ -0,0 +1,285 @@
+#include "sr_pch.h"
+#include "core/sr_texture.h"
+#include "core/sr_simd.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb/stb_image.h"
+
+static int32_t WrapCoord(int32_t coord, int32_t size, TEXTURE_WRAP wrap)
+{
+	if (wrap == TEXTURE_WRAP::CLAMP)
+	{
+		return math::Clamp(coord, 0, size - 1);
+	}
+
+	const int32_t wrapped = coord % size;
+	return wrapped < 0 ? wrapped + size : wrapped;
+}
+
+static __m128 UnpackTexel(uint32_t texel)
+{
+	// RGBA8 -> four floats in [0, 1]
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bytes = _mm_cvtsi32_si128(static_cast<int32_t>(texel));
+	const __m128i words = _mm_unpacklo_epi8(bytes, zero);
+	const __m128i dwords = _mm_unpacklo_epi16(words, zero);
+	return _mm_mul_ps(_mm_cvtepi32_ps(dwords), _mm_set1_ps(1.0f / 255.0f));
+}
+
+static math::Vector4 ToVector4(__m128 value)
+{
+	math::Vector4 result;
+	_mm_storeu_ps(&result.x, value);
+	return result;
+}
+
+static void StoreLevel(const TextureLevel& level, uint32_t* texels, const uint8_t* pixels)
+{
+	// Texels of the padding are copies of the nearest edge texel
+	const int32_t padded_width = level.num_tiles_x * TEXTURE_TILE_SIZE;
+	const int32_t padded_height = level.num_tiles_y * TEXTURE_TILE_SIZE;
+	for (int32_t y = 0; y < padded_height; ++y)
+	{
+		const uint8_t* src_row = pixels + math::Min(y, level.height - 1) * level.width * 4;
+		for (int32_t x = 0; x < padded_width; ++x)
+		{
+			uint32_t texel;
+			memcpy(&texel, src_row + math::Min(x, level.width - 1) * 4, sizeof(uint32_t));
+			texels[texture::TexelOffset(level, x, y)] = texel;
+		}
+	}
+}
+
+static void DownsampleLevel(const uint8_t* src, int32_t src_width, int32_t src_height, uint8_t* dst, int32_t dst_width, int32_t dst_height)
+{
+	// 2x2 box filter, odd sizes repeat the last row or column of the source
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rounding = _mm_set1_epi16(2);
+	for (int32_t y = 0; y < dst_height; ++y)
+	{
+		const uint8_t* src_row0 = src + math::Min(y * 2, src_height - 1) * src_width * 4;
+		const uint8_t* src_row1 = src + math::Min(y * 2 + 1, src_height - 1) * src_width * 4;
+		uint8_t* dst_row = dst + y * dst_width * 4;
+
+		// Two destination texels from four source texels of both rows at a time
+		int32_t x = 0;
+		for (; x * 2 + 4 <= src_width && x + 2 <= dst_width; x += 2)
+		{
+			const __m128i row0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_row0 + x * 8));
+			const __m128i row1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_row1 + x * 8));
+			const __m128i sum_low = _mm_add_epi16(_mm_unpacklo_epi8(row0, zero), _mm_unpacklo_epi8(row1, zero));
+			const __m128i sum_high = _mm_add_epi16(_mm_unpackhi_epi8(row0, zero), _mm_unpackhi_epi8(row1, zero));
+			const __m128i sum0 = _mm_add_epi16(sum_low, _mm_srli_si128(sum_low, 8));
+			const __m128i sum1 = _mm_add_epi16(sum_high, _mm_srli_si128(sum_high, 8));
+			const __m128i average = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sum0, sum1), rounding), 2);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst_row + x * 4), _mm_packus_epi16(average, zero));
+		}
+
+		for (; x < dst_width; ++x)
+		{
+			const int32_t x0 = math::Min(x * 2, src_width - 1) * 4;
+			const int32_t x1 = math::Min(x * 2 + 1, src_width - 1) * 4;
+			for (int32_t channel = 0; channel < 4; ++channel)
+			{
+				const int32_t sum = src_row0[x0 + channel] + src_row0[x1 + channel] + src_row1[x0 + channel] + src_row1[x1 + channel];
+				dst_row[x * 4 + channel] = static_cast<uint8_t>((sum + 2) >> 2);
+			}
+		}
+	}
+}
+
+static __m128 SampleBilinear(const TextureLevel& level, const SamplerState& sampler, float u, float v)
+{
+	const float fx = u * static_cast<float>(level.width);
+	const float fy = v * static_cast<float>(level.height);
+
+	if (sampler.filter == TEXTURE_FILTER::POINT)
+	{
+		const int32_t x = WrapCoord(math::FloorToInt(fx), level.width, sampler.wrap_u);
+		const int32_t y = WrapCoord(math::FloorToInt(fy), level.height, sampler.wrap_v);
+		return UnpackTexel(level.texels[texture::TexelOffset(level, x, y)]);
+	}
+
+	// Bilinear footprint around the sample, texel centers sit at half-integer coordinates
+	const float sample_x = fx - 0.5f;
+	const float sample_y = fy - 0.5f;
+	const int32_t floor_x = math::FloorToInt(sample_x);
+	const int32_t floor_y = math::FloorToInt(sample_y);
+	const float tx = sample_x - static_cast<float>(floor_x);
+	const float ty = sample_y - static_cast<float>(floor_y);
+
+	const int32_t x0 = WrapCoord(floor_x, level.width, sampler.wrap_u);
+	const int32_t x1 = WrapCoord(floor_x + 1, level.width, sampler.wrap_u);
+	const int32_t y0 = WrapCoord(floor_y, level.height, sampler.wrap_v);
+	const int32_t y1 = WrapCoord(floor_y + 1, level.height, sampler.wrap_v);
+
+	const __m128 texel00 = UnpackTexel(level.texels[texture::TexelOffset(level, x0, y0)]);
+	const __m128 texel10 = UnpackTexel(level.texels[texture::TexelOffset(level, x1, y0)]);
+	const __m128 texel01 = UnpackTexel(level.texels[texture::TexelOffset(level, x0, y1)]);
+	const __m128 texel11 = UnpackTexel(level.texels[texture::TexelOffset(level, x1, y1)]);
+
+	const __m128 weight_x = _mm_set1_ps(tx);
+	const __m128 weight_y = _mm_set1_ps(ty);
+	const __m128 top = _mm_add_ps(texel00, _mm_mul_ps(_mm_sub_ps(texel10, texel00), weight_x));
+	const __m128 bottom = _mm_add_ps(texel01, _mm_mul_ps(_mm_sub_ps(texel11, texel01), weight_x));
+	return _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), weight_y));
+}
+
+static simd::Float FootprintLength(simd::Float u_derivative, simd::Float v_derivative, simd::Float width, simd::Float height)
+{
+	// Squared texel-space length of one footprint axis, the same products as ComputeLod
+	const simd::Float u_length = simd::Mul(simd::Mul(simd::Mul(u_derivative, u_derivative), width), width);
+	const simd::Float v_length = simd::Mul(simd::Mul(simd::Mul(v_derivative, v_derivative), height), height);
+	return simd::Add(u_length, v_length);
+}
+
+int32_t texture::MakeLevels(Texture2D& texture, int32_t width, int32_t height)
+{
+	SR_ASSERT(width > 0 && height > 0);
+	SR_ASSERT(width <= MAX_TEXTURE_SIZE && height <= MAX_TEXTURE_SIZE);
+
+	texture.width = width;
+	texture.height = height;
+	texture.num_levels = 0;
+
+	int32_t num_texels = 0;
+	while (texture.num_levels < MAX_TEXTURE_LEVELS)
+	{
+		TextureLevel& level = texture.levels[texture.num_levels++];
+		level.texels = nullptr;
+		level.width = width;
+		level.height = height;
+		level.num_tiles_x = (width + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+		level.num_tiles_y = (height + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+		num_texels += level.num_tiles_x * level.num_tiles_y * TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE;
+
+		if (width == 1 && height == 1)
+		{
+			break;
+		}
+
+		width = math::Max(width / 2, 1);
+		height = math::Max(height / 2, 1);
+	}
+
+	return num_texels;
+}
+
+void texture::StoreTexels(Texture2D& texture, uint32_t* texels, const uint8_t* pixels)
+{
+	SR_ASSERT(texels && pixels);
+	SR_ASSERT(texture.num_levels > 0);
+
+	// Levels are packed back to back, every level is a whole number of tiles
+	uint32_t* level_texels[MAX_TEXTURE_LEVELS];
+	for (int32_t i = 0; i < texture.num_levels; ++i)
+	{
+		TextureLevel& level = texture.levels[i];
+		level.texels = texels;
+		level_texels[i] = texels;
+		texels += level.num_tiles_x * level.num_tiles_y * TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE;
+	}
+
+	StoreLevel(texture.levels[0], level_texels[0], pixels);
+	if (texture.num_levels == 1)
+	{
+		return;
+	}
+
+	// Every level is filtered from the row-major copy of the previous one
+	std::vector<uint8_t> src_pixels(pixels, pixels + texture.width * texture.height * 4);
+	std::vector<uint8_t> dst_pixels;
+	for (int32_t i = 1; i < texture.num_levels; ++i)
+	{
+		const TextureLevel& src_level = texture.levels[i - 1];
+		const TextureLevel& dst_level = texture.levels[i];
+		dst_pixels.resize(dst_level.width * dst_level.height * 4);
+		DownsampleLevel(src_pixels.data(), src_level.width, src_level.height, dst_pixels.data(), dst_level.width, dst_level.height);
+		StoreLevel(dst_level, level_texels[i], dst_pixels.data());
+		src_pixels.swap(dst_pixels);
+	}
+}
+
+float texture::ComputeLod(const Texture2D& texture, float u_ddx, float v_ddx, float u_ddy, float v_ddy)
+{
+	// log2 of the longer texel-space footprint axis, taken as 0.5 * log2 of its squared length
+	const float width = static_cast<float>(texture.width);
+	const float height = static_cast<float>(texture.height);
+	const float length_x = u_ddx * u_ddx * width * width + v_ddx * v_ddx * height * height;
+	const float length_y = u_ddy * u_ddy * width * width + v_ddy * v_ddy * height * height;
+	const float length = math::Max(length_x, length_y);
+	return length > 0.0f ? 0.5f * log2f(length) : 0.0f;
+}
+
+math::Vector4 texture::Sample(const Texture2D& texture, const SamplerState& sampler, float u, float v)
+{
+	return ToVector4(SampleBilinear(texture.levels[0], sampler, u, v));
+}
+
+math::Vector4 texture::SampleLevel(const Texture2D& texture, const SamplerState& sampler, float u, float v, float lod)
+{
+	const float max_lod = static_cast<float>(texture.num_levels - 1);
+	lod = math::Clamp(lod, 0.0f, max_lod);
+
+	switch (sampler.mip_filter)
+	{
+	case TEXTURE_MIP_FILTER::NONE:
+		return ToVector4(SampleBilinear(texture.levels[0], sampler, u, v));
+	case TEXTURE_MIP_FILTER::POINT:
+		return ToVector4(SampleBilinear(texture.levels[math::RoundToInt(lod)], sampler, u, v));
+	case TEXTURE_MIP_FILTER::LINEAR:
+		break;
+	}
+
+	// Trilinear, blend the two nearest levels
+	const int32_t level0 = math::FloorToInt(lod);
+	const int32_t level1 = math::Min(level0 + 1, texture.num_levels - 1);
+	const __m128 texel0 = SampleBilinear(texture.levels[level0], sampler, u, v);
+	if (level0 == level1)
+	{
+		return ToVector4(texel0);
+	}
+
+	const __m128 texel1 = SampleBilinear(texture.levels[level1], sampler, u, v);
+	const __m128 weight = _mm_set1_ps(lod - static_cast<float>(level0));
+	return ToVector4(_mm_add_ps(texel0, _mm_mul_ps(_mm_sub_ps(texel1, texel0), weight)));
+}
+
+math::Vector4 texture::SampleGrad(const Texture2D& texture, const SamplerState& sampler, float u, float v, float u_ddx, float v_ddx, float u_ddy, float v_ddy)
+{
+	return SampleLevel(texture, sampler, u, v, ComputeLod(texture, u_ddx, v_ddx, u_ddy, v_ddy));
+}
+
+void texture::SampleBatch(const Texture2D& texture, const SamplerState& sampler, int32_t count, const float* u, const float* v, const float* u_ddx, const float* v_ddx, const float* u_ddy, const float* v_ddy, math::Vector4* colors)
+{
+	if (sampler.mip_filter == TEXTURE_MIP_FILTER::NONE)
+	{
+		for (int32_t i = 0; i < count; ++i)
+		{
+			colors[i] = ToVector4(SampleBilinear(texture.levels[0], sampler, u[i], v[i]));
+		}
+		return;
+	}
+
+	// Footprints of simd::WIDTH pixels at a time, the remaining pixels go through SampleGrad one by one
+	const simd::Float width = simd::Set(static_cast<float>(texture.width));
+	const simd::Float height = simd::Set(static_cast<float>(texture.height));
+	alignas(32) float lengths[simd::WIDTH];
+	int32_t i = 0;
+	for (; i + simd::WIDTH <= count; i += simd::WIDTH)
+	{
+		const simd::Float length_x = FootprintLength(simd::Load(u_ddx + i), simd::Load(v_ddx + i), width, height);
+		const simd::Float length_y = FootprintLength(simd::Load(u_ddy + i), simd::Load(v_ddy + i), width, height);
+		simd::Store(lengths, simd::Max(length_x, length_y));
+		for (int32_t j = 0; j < simd::WIDTH; ++j)
+		{
+			const float lod = lengths[j] > 0.0f ? 0.5f * log2f(lengths[j]) : 0.0f;
+			colors[i + j] = SampleLevel(texture, sampler, u[i + j], v[i + j], lod);
+		}
+	}
+
+	for (; i < count; ++i)
+	{
+		colors[i] = SampleGrad(texture, sampler, u[i], v[i], u_ddx[i], v_ddx[i], u_ddy[i], v_ddy[i]);
+	}
+}
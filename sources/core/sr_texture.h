@@ -0,0 +1,33 @@
+#pragma once
+
+#include "core/sr_core_types.h"
+#include "core/sr_math.h"
+
+namespace texture
+{
+	/* texel (x, y) of the tiled layout, texels of a tile are stored row by row */
+	inline int32_t TexelOffset(const TextureLevel& level, int32_t x, int32_t y);
+
+	/* sizes of the full mip chain down to 1x1, width and height in [1, MAX_TEXTURE_SIZE], returns the number of texels of all levels */
+	int32_t MakeLevels(Texture2D& texture, int32_t width, int32_t height);
+
+	/* copies row-major RGBA8 pixels into level 0 of texels and filters every smaller level from the previous one */
+	void StoreTexels(Texture2D& texture, uint32_t* texels, const uint8_t* pixels);
+
+	/* level of detail from the screen-space derivatives of u and v */
+	float ComputeLod(const Texture2D& texture, float u_ddx, float v_ddx, float u_ddy, float v_ddy);
+
+	/* u, v in [0, 1] cover the texture once, outside that range the wrap modes apply */
+	math::Vector4 Sample(const Texture2D& texture, const SamplerState& sampler, float u, float v);
+	math::Vector4 SampleLevel(const Texture2D& texture, const SamplerState& sampler, float u, float v, float lod);
+	math::Vector4 SampleGrad(const Texture2D& texture, const SamplerState& sampler, float u, float v, float u_ddx, float v_ddx, float u_ddy, float v_ddy);
+
+	/* SampleGrad of count pixels, the footprints are computed simd::WIDTH pixels at a time */
+	void SampleBatch(const Texture2D& texture, const SamplerState& sampler, int32_t count, const float* u, const float* v, const float* u_ddx, const float* v_ddx, const float* u_ddy, const float* v_ddy, math::Vector4* colors);
+}
+
+int32_t texture::TexelOffset(const TextureLevel& level, int32_t x, int32_t y)
+{
+	const int32_t tile_index = (y / TEXTURE_TILE_SIZE) * level.num_tiles_x + x / TEXTURE_TILE_SIZE;
+	return tile_index * TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE + (y % TEXTURE_TILE_SIZE) * TEXTURE_TILE_SIZE + x % TEXTURE_TILE_SIZE;
+}
@@ -0,0 +1,320 @@
+#include "sr_pch.h"
+#include "core/sr_texture_cache.h"
+#include "core/sr_texture.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// File layout: header, entries sorted by name, then the texels of every texture on 64-byte boundaries
+static constexpr uint32_t CACHE_MAGIC = 0x43545253; // "SRTC"
+static constexpr uint32_t CACHE_VERSION = (1 << 16) | (TEXTURE_TILE_SIZE << 8) | MAX_TEXTURE_LEVELS;
+static constexpr uint64_t CACHE_ALIGNMENT = 64;
+
+struct CacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t num_entries;
+	uint32_t reserved;
+};
+
+struct CacheEntry
+{
+	char name[TextureCache::MAX_NAME_LENGTH];
+	int32_t width;
+	int32_t height;
+	int32_t num_levels;
+	uint32_t reserved;
+	uint64_t offset;
+};
+
+static uint64_t AlignOffset(uint64_t offset)
+{
+	return (offset + CACHE_ALIGNMENT - 1) & ~(CACHE_ALIGNMENT - 1);
+}
+
+TextureCache::TextureCache()
+	: data_(nullptr)
+	, size_(0)
+	, file_handle_(nullptr)
+	, mapping_handle_(nullptr)
+{
+}
+
+TextureCache::~TextureCache()
+{
+	Close();
+}
+
+bool TextureCache::Build(const char* cache_filename, const char* const* image_filenames, int32_t num_images)
+{
+	SR_ASSERT(cache_filename);
+	SR_ASSERT(image_filenames || num_images == 0);
+
+	// Sizes come from the image headers, so the table is written before anything is decoded
+	std::vector<CacheEntry> entries(num_images);
+	for (int32_t i = 0; i < num_images; ++i)
+	{
+		CacheEntry& entry = entries[i];
+		memset(&entry, 0, sizeof(CacheEntry));
+
+		const size_t name_length = strlen(image_filenames[i]);
+		int32_t num_channels = 0;
+		if (name_length >= MAX_NAME_LENGTH || !stbi_info(image_filenames[i], &entry.width, &entry.height, &num_channels) ||
+			entry.width > MAX_TEXTURE_SIZE || entry.height > MAX_TEXTURE_SIZE)
+		{
+			return false;
+		}
+
+		memcpy(entry.name, image_filenames[i], name_length);
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const CacheEntry& a, const CacheEntry& b)
+	{
+		return strcmp(a.name, b.name) < 0;
+	});
+
+	uint64_t offset = AlignOffset(sizeof(CacheHeader) + sizeof(CacheEntry) * entries.size());
+	for (CacheEntry& entry : entries)
+	{
+		Texture2D texture;
+		const int32_t num_texels = texture::MakeLevels(texture, entry.width, entry.height);
+		entry.num_levels = texture.num_levels;
+		entry.offset = offset;
+		offset = AlignOffset(offset + num_texels * sizeof(uint32_t));
+	}
+
+	std::ofstream file(cache_filename, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		return false;
+	}
+
+	CacheHeader header;
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.num_entries = static_cast<uint32_t>(entries.size());
+	header.reserved = 0;
+	file.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+	file.write(reinterpret_cast<const char*>(entries.data()), sizeof(CacheEntry) * entries.size());
+
+	// One image is decoded at a time, so building a large set does not need all of it in memory
+	const char padding[CACHE_ALIGNMENT] = {};
+	std::vector<uint32_t> texels;
+	for (const CacheEntry& entry : entries)
+	{
+		int32_t width = 0;
+		int32_t height = 0;
+		int32_t num_channels = 0;
+		uint8_t* pixels = stbi_load(entry.name, &width, &height, &num_channels, 4);
+		if (!pixels || width != entry.width || height != entry.height)
+		{
+			stbi_image_free(pixels);
+			return false;
+		}
+
+		Texture2D texture;
+		texels.resize(texture::MakeLevels(texture, width, height));
+		texture::StoreTexels(texture, texels.data(), pixels);
+		stbi_image_free(pixels);
+
+		const uint64_t position = static_cast<uint64_t>(file.tellp());
+		file.write(padding, static_cast<std::streamsize>(entry.offset - position));
+		file.write(reinterpret_cast<const char*>(texels.data()), texels.size() * sizeof(uint32_t));
+	}
+
+	return static_cast<bool>(file);
+}
+
+bool TextureCache::Open(const char* cache_filename)
+{
+	SR_ASSERT(cache_filename);
+
+	Close();
+	if (!Map(cache_filename))
+	{
+		return false;
+	}
+
+	CacheHeader header;
+	if (size_ < sizeof(CacheHeader))
+	{
+		Close();
+		return false;
+	}
+
+	memcpy(&header, data_, sizeof(CacheHeader));
+	if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || size_ < sizeof(CacheHeader) + sizeof(CacheEntry) * static_cast<uint64_t>(header.num_entries))
+	{
+		Close();
+		return false;
+	}
+
+	// Only the small per-texture headers are built here, the levels point into the mapping
+	// Every field of an entry is checked before the levels are made from it, a corrupt file fails to open
+	const CacheEntry* cache_entries = reinterpret_cast<const CacheEntry*>(data_ + sizeof(CacheHeader));
+	entries_.resize(header.num_entries);
+	for (uint32_t i = 0; i < header.num_entries; ++i)
+	{
+		const CacheEntry& cache_entry = cache_entries[i];
+		if (cache_entry.name[MAX_NAME_LENGTH - 1] != '\0' || (i > 0 && strcmp(cache_entries[i - 1].name, cache_entry.name) >= 0) ||
+			cache_entry.width <= 0 || cache_entry.width > MAX_TEXTURE_SIZE || cache_entry.height <= 0 || cache_entry.height > MAX_TEXTURE_SIZE ||
+			cache_entry.offset % CACHE_ALIGNMENT != 0 || cache_entry.offset > size_)
+		{
+			Close();
+			return false;
+		}
+
+		Entry& entry = entries_[i];
+		entry.name = cache_entry.name;
+
+		const uint64_t num_texels = texture::MakeLevels(entry.texture, cache_entry.width, cache_entry.height);
+		if (entry.texture.num_levels != cache_entry.num_levels || num_texels * sizeof(uint32_t) > size_ - cache_entry.offset)
+		{
+			Close();
+			return false;
+		}
+
+		const uint32_t* texels = reinterpret_cast<const uint32_t*>(data_ + cache_entry.offset);
+		for (int32_t level = 0; level < entry.texture.num_levels; ++level)
+		{
+			TextureLevel& texture_level = entry.texture.levels[level];
+			texture_level.texels = texels;
+			texels += texture_level.num_tiles_x * texture_level.num_tiles_y * TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE;
+		}
+	}
+
+	return true;
+}
+
+void TextureCache::Close()
+{
+	entries_.clear();
+	Unmap();
+}
+
+int32_t TextureCache::GetNumTextures() const
+{
+	return static_cast<int32_t>(entries_.size());
+}
+
+const Texture2D* TextureCache::Find(const char* image_filename) const
+{
+	SR_ASSERT(image_filename);
+
+	const auto it = std::lower_bound(entries_.begin(), entries_.end(), image_filename, [](const Entry& entry, const char* name)
+	{
+		return strcmp(entry.name, name) < 0;
+	});
+
+	if (it == entries_.end() || strcmp(it->name, image_filename) != 0)
+	{
+		return nullptr;
+	}
+
+	return &it->texture;
+}
+
+#if defined(_WIN32)
+
+bool TextureCache::Map(const char* cache_filename)
+{
+	HANDLE file = CreateFileA(cache_filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	data_ = reinterpret_cast<const uint8_t*>(data);
+	size_ = static_cast<size_t>(file_size.QuadPart);
+	file_handle_ = file;
+	mapping_handle_ = mapping;
+	return true;
+}
+
+void TextureCache::Unmap()
+{
+	if (data_)
+	{
+		UnmapViewOfFile(data_);
+		CloseHandle(mapping_handle_);
+		CloseHandle(file_handle_);
+	}
+
+	data_ = nullptr;
+	size_ = 0;
+	file_handle_ = nullptr;
+	mapping_handle_ = nullptr;
+}
+
+#else
+
+bool TextureCache::Map(const char* cache_filename)
+{
+	const int file = open(cache_filename, O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat file_stat;
+	if (fstat(file, &file_stat) != 0 || file_stat.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+
+	// The mapping keeps its own reference to the file
+	void* data = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+
+	data_ = reinterpret_cast<const uint8_t*>(data);
+	size_ = static_cast<size_t>(file_stat.st_size);
+	return true;
+}
+
+void TextureCache::Unmap()
+{
+	if (data_)
+	{
+		munmap(const_cast<uint8_t*>(data_), size_);
+	}
+
+	data_ = nullptr;
+	size_ = 0;
+}
+
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "core/sr_core_types.h"
+
+/*
+ * Preprocessed textures in one file, in the final tiled and mipmapped layout
+ * Build decodes the images once and writes their texels, Open maps the file and
+ * points the texture levels straight into the mapping, so loading does no decode
+ * and no copy. Mapped texels are read-only and live until Close.
+ */
+class TextureCache
+{
+public:
+	static constexpr int32_t MAX_NAME_LENGTH = 256;
+
+	TextureCache();
+	~TextureCache();
+
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+
+	// Decodes every image and writes it to the cache file under its filename, returns false if any image or the write fails
+	static bool Build(const char* cache_filename, const char* const* image_filenames, int32_t num_images);
+
+	// Returns false if the file is missing, was written with a different layout or any entry is out of range
+	bool Open(const char* cache_filename);
+	void Close();
+
+	int32_t GetNumTextures() const;
+
+	// nullptr if the image is not in the cache
+	const Texture2D* Find(const char* image_filename) const;
+
+private:
+	struct Entry
+	{
+		const char* name;
+		Texture2D texture;
+	};
+
+	bool Map(const char* cache_filename);
+	void Unmap();
+
+private:
+	const uint8_t* data_;
+	size_t size_;
+	void* file_handle_;
+	void* mapping_handle_;
+
+	// Sorted by name
+	std::vector<Entry> entries_;
+};
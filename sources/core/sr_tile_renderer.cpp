@@ -0,0 +1,146 @@
+#include "sr_pch.h"
+#include "core/sr_tile_renderer.h"
+#include "core/sr_job_system.h"
+#include "shaders/sr_shader_interface.h"
+
+TileRenderer::TileRenderer(JobSystem* job_system, FrameArena* frame_arena, int32_t width, int32_t height)
+	: job_system_(job_system)
+	, frame_arena_(frame_arena)
+	, num_tiles_x_((width + TILE_SIZE - 1) / TILE_SIZE)
+	, num_tiles_y_((height + TILE_SIZE - 1) / TILE_SIZE)
+	, frame_buffer_()
+	, context_(nullptr)
+	, rasterize_function_(nullptr)
+	, num_triangles_(0)
+{
+	SR_ASSERT(job_system_ && frame_arena_);
+
+	bins_.resize(num_tiles_x_ * num_tiles_y_);
+	thread_contexts_.resize(job_system_->GetNumThreads());
+}
+
+void TileRenderer::Begin(const FrameBuffer& frame_buffer, PipelineContext& context, rasterizer::RasterizeFunction rasterize_function)
+{
+	SR_ASSERT(rasterize_function);
+	SR_ASSERT((frame_buffer.width + TILE_SIZE - 1) / TILE_SIZE == num_tiles_x_);
+	SR_ASSERT((frame_buffer.height + TILE_SIZE - 1) / TILE_SIZE == num_tiles_y_);
+
+	frame_buffer_ = frame_buffer;
+	context_ = &context;
+	rasterize_function_ = rasterize_function;
+
+	num_triangles_ = 0;
+	for (FrameList<const rasterizer::Triangle*>& bin : bins_)
+	{
+		bin.Clear();
+	}
+}
+
+void TileRenderer::Submit(const math::Vector4 clip_coords[3], void* varyings[3])
+{
+	SR_ASSERT(context_);
+
+	math::Vector4 polygon_clip_coords[rasterizer::MAX_CLIP_VERTICES];
+	void* polygon_varyings[rasterizer::MAX_CLIP_VERTICES];
+	const int32_t num_vertices = rasterizer::ClipTriangle(polygon_clip_coords, polygon_varyings, frame_buffer_, *context_, clip_coords, varyings);
+
+	// Clipping writes new varyings into the context scratch, which the next Submit reuses
+	const uint8_t* clip_varyings = reinterpret_cast<const uint8_t*>(context_->clip_varyings);
+	for (int32_t i = 0; i < num_vertices; ++i)
+	{
+		const uint8_t* vertex_varyings = reinterpret_cast<const uint8_t*>(polygon_varyings[i]);
+		if (clip_varyings && vertex_varyings >= clip_varyings && vertex_varyings < clip_varyings + rasterizer::MAX_CLIP_VARYINGS * context_->sizeof_varyings)
+		{
+			void* stored_varyings = frame_arena_->Allocate(JobSystem::CALLING_THREAD_INDEX, context_->sizeof_varyings);
+			memcpy(stored_varyings, vertex_varyings, context_->sizeof_varyings);
+			polygon_varyings[i] = stored_varyings;
+		}
+	}
+
+	for (int32_t i = 1; i + 1 < num_vertices; ++i)
+	{
+		const math::Vector4 fan_clip_coords[3] = { polygon_clip_coords[0], polygon_clip_coords[i], polygon_clip_coords[i + 1] };
+		void* fan_varyings[3] = { polygon_varyings[0], polygon_varyings[i], polygon_varyings[i + 1] };
+		SubmitTriangle(fan_clip_coords, fan_varyings);
+	}
+}
+
+void TileRenderer::SubmitTriangle(const math::Vector4 clip_coords[3], void* varyings[3])
+{
+	rasterizer::Triangle triangle;
+	if (!rasterizer::SetupTriangle(triangle, frame_buffer_, *context_, clip_coords, varyings))
+	{
+		return;
+	}
+
+	rasterizer::Triangle* stored_triangle = frame_arena_->AllocateArray<rasterizer::Triangle>(JobSystem::CALLING_THREAD_INDEX, 1);
+	*stored_triangle = triangle;
+	++num_triangles_;
+
+	// Bin the triangle into every tile its bounding box overlaps
+	const BoundingBox& box = triangle.bounding_box;
+	const int32_t min_tile_x = box.min_x / TILE_SIZE;
+	const int32_t min_tile_y = box.min_y / TILE_SIZE;
+	const int32_t max_tile_x = (box.max_x - 1) / TILE_SIZE;
+	const int32_t max_tile_y = (box.max_y - 1) / TILE_SIZE;
+	for (int32_t tile_y = min_tile_y; tile_y <= max_tile_y; ++tile_y)
+	{
+		for (int32_t tile_x = min_tile_x; tile_x <= max_tile_x; ++tile_x)
+		{
+			bins_[tile_y * num_tiles_x_ + tile_x].Push(*frame_arena_, JobSystem::CALLING_THREAD_INDEX, stored_triangle);
+		}
+	}
+}
+
+void TileRenderer::End()
+{
+	SR_ASSERT(context_);
+
+	if (num_triangles_ > 0)
+	{
+		// No job runs yet, so the sub-arena of every thread can be used from here
+		for (int32_t i = 0; i < static_cast<int32_t>(thread_contexts_.size()); ++i)
+		{
+			thread_contexts_[i] = *context_;
+			thread_contexts_[i].shader_varyings = frame_arena_->Allocate(i, context_->sizeof_varyings * PIXEL_BATCH_SIZE);
+			thread_contexts_[i].shader_derivatives = frame_arena_->Allocate(i, context_->sizeof_varyings * PIXEL_BATCH_SIZE * 2);
+
+			// Only the components of the varying layout are interpolated, the others read as zero
+			memset(thread_contexts_[i].shader_varyings, 0, context_->sizeof_varyings * PIXEL_BATCH_SIZE);
+			memset(thread_contexts_[i].shader_derivatives, 0, context_->sizeof_varyings * PIXEL_BATCH_SIZE * 2);
+		}
+
+		const int32_t num_tiles = num_tiles_x_ * num_tiles_y_;
+		job_system_->ParallelFor(num_tiles, [this](int32_t tile_index, int32_t thread_index)
+		{
+			RasterizeTile(tile_index, thread_index);
+		});
+	}
+
+	context_ = nullptr;
+}
+
+void TileRenderer::RasterizeTile(int32_t tile_index, int32_t thread_index)
+{
+	const FrameList<const rasterizer::Triangle*>& bin = bins_[tile_index];
+	if (bin.IsEmpty())
+	{
+		return;
+	}
+
+	const int32_t tile_x = tile_index % num_tiles_x_;
+	const int32_t tile_y = tile_index / num_tiles_x_;
+
+	BoundingBox tile_rect;
+	tile_rect.min_x = tile_x * TILE_SIZE;
+	tile_rect.min_y = tile_y * TILE_SIZE;
+	tile_rect.max_x = math::Min(tile_rect.min_x + TILE_SIZE, frame_buffer_.width);
+	tile_rect.max_y = math::Min(tile_rect.min_y + TILE_SIZE, frame_buffer_.height);
+
+	// Triangles are stored in submission order, so blending inside the tile stays correct
+	PipelineContext& context = thread_contexts_[thread_index];
+	bin.ForEach([this, &context, &tile_rect](const rasterizer::Triangle* triangle)
+	{
+		rasterize_function_(frame_buffer_, context, *triangle, tile_rect);
+	});
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "core/sr_core_types.h"
+#include "core/sr_frame_arena.h"
+#include "core/sr_rasterizer.h"
+
+class JobSystem;
+
+/*
+ * Sort-middle rasterization
+ * Triangles are set up once and binned into screen tiles, then every tile is
+ * rasterized by exactly one worker thread in submission order.
+ */
+class TileRenderer
+{
+public:
+	static constexpr int32_t TILE_SIZE = 64;
+
+	TileRenderer(JobSystem* job_system, FrameArena* frame_arena, int32_t width, int32_t height);
+
+	void Begin(const FrameBuffer& frame_buffer, PipelineContext& context, rasterizer::RasterizeFunction rasterize_function);
+	void Submit(const math::Vector4 clip_coords[3], void* varyings[3]);
+	void End();
+
+private:
+	void SubmitTriangle(const math::Vector4 clip_coords[3], void* varyings[3]);
+	void RasterizeTile(int32_t tile_index, int32_t thread_index);
+
+private:
+	JobSystem* job_system_;
+	FrameArena* frame_arena_;
+
+	int32_t num_tiles_x_;
+	int32_t num_tiles_y_;
+
+	FrameBuffer frame_buffer_;
+	PipelineContext* context_;
+	rasterizer::RasterizeFunction rasterize_function_;
+
+	// Set up triangles and the bins pointing at them live in the frame arena, bins keep submission order
+	int32_t num_triangles_;
+	std::vector<FrameList<const rasterizer::Triangle*>> bins_;
+
+	// Each thread interpolates into its own copy of the context varyings and derivatives,
+	// those and the varyings of clipped vertices are allocated from the frame arena
+	std::vector<PipelineContext> thread_contexts_;
+};
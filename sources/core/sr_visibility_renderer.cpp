@@ -0,0 +1,182 @@
+#include "sr_pch.h"
+#include "core/sr_visibility_renderer.h"
+#include "core/sr_frame_buffer.h"
+#include "core/sr_job_system.h"
+#include "shaders/sr_shader_interface.h"
+
+uint32_t VisibilityRenderer::MakeId(int32_t draw_id, int32_t triangle_id)
+{
+	SR_ASSERT(draw_id >= 0 && draw_id < MAX_DRAWS);
+	SR_ASSERT(triangle_id >= 0 && triangle_id < MAX_TRIANGLES);
+	return (static_cast<uint32_t>(draw_id) << TRIANGLE_ID_BITS) | static_cast<uint32_t>(triangle_id);
+}
+
+VisibilityRenderer::VisibilityRenderer(JobSystem* job_system, FrameArena* frame_arena)
+	: job_system_(job_system)
+	, frame_arena_(frame_arena)
+	, resolve_draws_(nullptr)
+{
+	SR_ASSERT(job_system_ && frame_arena_);
+	thread_data_.resize(job_system_->GetNumThreads());
+}
+
+void VisibilityRenderer::Reset()
+{
+	draws_.Clear();
+	resolve_draws_ = nullptr;
+}
+
+int32_t VisibilityRenderer::AddDraw(const FrameBuffer& frame_buffer, const PipelineContext& context, const math::Vector4* clip_coords, const uint8_t* varyings, const uint32_t* triangle_vertices, int32_t num_triangles)
+{
+	SR_ASSERT(draws_.GetSize() < MAX_DRAWS);
+	SR_ASSERT(num_triangles <= MAX_TRIANGLES);
+	SR_ASSERT(context.shader && !context.shader->CanDiscard());
+
+	Draw draw;
+	draw.frame_buffer = frame_buffer;
+	draw.frame_buffer.visibility_buffer = nullptr;
+	draw.context = context;
+
+	// Constants change between draws, the vertex stage output stays in place until the end of the frame
+	draw.context.shader_constants = frame_arena_->Allocate(JobSystem::CALLING_THREAD_INDEX, context.sizeof_constants);
+	memcpy(draw.context.shader_constants, context.shader_constants, context.sizeof_constants);
+	draw.clip_coords = clip_coords;
+	draw.varyings = varyings;
+	draw.triangle_vertices = triangle_vertices;
+
+	const int32_t draw_id = draws_.GetSize();
+	draws_.Push(*frame_arena_, JobSystem::CALLING_THREAD_INDEX, draw);
+	return draw_id;
+}
+
+void VisibilityRenderer::Resolve(const FrameBuffer& frame_buffer)
+{
+	SR_ASSERT(frame_buffer.visibility_buffer);
+
+	const int32_t num_draws = draws_.GetSize();
+	if (num_draws == 0)
+	{
+		return;
+	}
+
+	Draw* resolve_draws = frame_arena_->AllocateArray<Draw>(JobSystem::CALLING_THREAD_INDEX, num_draws);
+	draws_.CopyTo(resolve_draws);
+	resolve_draws_ = resolve_draws;
+
+	// Scratch of every thread is sized for the largest draw
+	int32_t max_sizeof_varyings = 0;
+	for (int32_t i = 0; i < num_draws; ++i)
+	{
+		max_sizeof_varyings = math::Max(max_sizeof_varyings, resolve_draws_[i].context.sizeof_varyings);
+	}
+
+	// No job runs yet, so the sub-arena of every thread can be used from here
+	for (int32_t i = 0; i < static_cast<int32_t>(thread_data_.size()); ++i)
+	{
+		ThreadData& thread_data = thread_data_[i];
+		thread_data.varyings = frame_arena_->AllocateArray<uint8_t>(i, max_sizeof_varyings * PIXEL_BATCH_SIZE);
+		thread_data.derivatives = frame_arena_->AllocateArray<uint8_t>(i, max_sizeof_varyings * PIXEL_BATCH_SIZE * 2);
+		thread_data.clip_varyings = frame_arena_->AllocateArray<uint8_t>(i, max_sizeof_varyings * rasterizer::MAX_CLIP_VARYINGS);
+		thread_data.pixel_keys = frame_arena_->AllocateArray<uint64_t>(i, TILE_SIZE * TILE_SIZE);
+		thread_data.pixel_indices = frame_arena_->AllocateArray<int32_t>(i, TILE_SIZE * TILE_SIZE);
+	}
+
+	const int32_t num_tiles_x = (frame_buffer.width + TILE_SIZE - 1) / TILE_SIZE;
+	const int32_t num_tiles_y = (frame_buffer.height + TILE_SIZE - 1) / TILE_SIZE;
+	job_system_->ParallelFor(num_tiles_x * num_tiles_y, [this, &frame_buffer](int32_t tile_index, int32_t thread_index)
+	{
+		ResolveTile(frame_buffer, tile_index, thread_index);
+	});
+}
+
+void VisibilityRenderer::ResolveTile(const FrameBuffer& frame_buffer, int32_t tile_index, int32_t thread_index)
+{
+	const int32_t num_tiles_x = (frame_buffer.width + TILE_SIZE - 1) / TILE_SIZE;
+	const int32_t min_x = (tile_index % num_tiles_x) * TILE_SIZE;
+	const int32_t min_y = (tile_index / num_tiles_x) * TILE_SIZE;
+	const int32_t max_x = math::Min(min_x + TILE_SIZE, frame_buffer.width);
+	const int32_t max_y = math::Min(min_y + TILE_SIZE, frame_buffer.height);
+
+	// Sorting by id groups the pixels of every triangle, so each one is set up once per tile
+	ThreadData& thread_data = thread_data_[thread_index];
+	uint64_t* pixel_keys = thread_data.pixel_keys;
+	int32_t num_pixel_keys = 0;
+	for (int32_t y = min_y; y < max_y; ++y)
+	{
+		for (int32_t x = min_x; x < max_x; ++x)
+		{
+			const int32_t index = framebuffer::PixelOffset(frame_buffer, x, y);
+			const uint32_t id = frame_buffer.visibility_buffer[index];
+			if (id != INVALID_ID)
+			{
+				pixel_keys[num_pixel_keys++] = (static_cast<uint64_t>(id) << 32) | static_cast<uint32_t>(index);
+			}
+		}
+	}
+
+	std::sort(pixel_keys, pixel_keys + num_pixel_keys);
+
+	int32_t current_draw_id = -1;
+	PipelineContext& context = thread_data.context;
+	int32_t* pixel_indices = thread_data.pixel_indices;
+	for (int32_t begin = 0; begin < num_pixel_keys;)
+	{
+		const uint32_t id = static_cast<uint32_t>(pixel_keys[begin] >> 32);
+		int32_t end = begin;
+		while (end < num_pixel_keys && static_cast<uint32_t>(pixel_keys[end] >> 32) == id)
+		{
+			pixel_indices[end - begin] = static_cast<int32_t>(pixel_keys[end] & 0xffffffff);
+			++end;
+		}
+
+		const int32_t draw_id = static_cast<int32_t>(id >> TRIANGLE_ID_BITS);
+		const int32_t triangle_id = static_cast<int32_t>(id & (MAX_TRIANGLES - 1));
+		SR_ASSERT(draw_id < draws_.GetSize());
+
+		const Draw& draw = resolve_draws_[draw_id];
+		if (draw_id != current_draw_id)
+		{
+			context = draw.context;
+			context.shader_varyings = thread_data.varyings;
+			context.shader_derivatives = thread_data.derivatives;
+			context.clip_varyings = thread_data.clip_varyings;
+			current_draw_id = draw_id;
+
+			// The layout of the previous draw may have written components this one never interpolates
+			memset(context.shader_varyings, 0, context.sizeof_varyings * PIXEL_BATCH_SIZE);
+			memset(context.shader_derivatives, 0, context.sizeof_varyings * PIXEL_BATCH_SIZE * 2);
+		}
+
+		ShadeTriangle(draw, context, triangle_id, pixel_indices, end - begin);
+		begin = end;
+	}
+}
+
+void VisibilityRenderer::ShadeTriangle(const Draw& draw, PipelineContext& context, int32_t triangle_id, const int32_t* pixel_indices, int32_t num_pixels)
+{
+	math::Vector4 clip_coords[3];
+	void* varyings[3];
+	for (int32_t i = 0; i < 3; ++i)
+	{
+		const uint32_t vertex = draw.triangle_vertices ? draw.triangle_vertices[triangle_id * 3 + i] : static_cast<uint32_t>(triangle_id * 3 + i);
+		clip_coords[i] = draw.clip_coords[vertex];
+		varyings[i] = const_cast<uint8_t*>(draw.varyings) + vertex * context.sizeof_varyings;
+	}
+
+	// Every piece of a clipped triangle lies in the same planes, the first one that sets up provides them
+	math::Vector4 polygon_clip_coords[rasterizer::MAX_CLIP_VERTICES];
+	void* polygon_varyings[rasterizer::MAX_CLIP_VERTICES];
+	const int32_t num_vertices = rasterizer::ClipTriangle(polygon_clip_coords, polygon_varyings, draw.frame_buffer, context, clip_coords, varyings);
+	for (int32_t i = 1; i + 1 < num_vertices; ++i)
+	{
+		const math::Vector4 fan_clip_coords[3] = { polygon_clip_coords[0], polygon_clip_coords[i], polygon_clip_coords[i + 1] };
+		void* fan_varyings[3] = { polygon_varyings[0], polygon_varyings[i], polygon_varyings[i + 1] };
+
+		rasterizer::Triangle triangle;
+		if (rasterizer::SetupTriangle(triangle, draw.frame_buffer, context, fan_clip_coords, fan_varyings))
+		{
+			rasterizer::ShadeTrianglePixels(draw.frame_buffer, context, triangle, pixel_indices, num_pixels);
+			return;
+		}
+	}
+}
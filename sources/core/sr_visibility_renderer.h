@@ -0,0 +1,72 @@
+#pragma once
+
+#include "core/sr_core_types.h"
+#include "core/sr_frame_arena.h"
+#include "core/sr_rasterizer.h"
+
+class JobSystem;
+
+/*
+ * Visibility buffer rendering
+ * The visibility pass stores depth and a (draw id, triangle id) pair per pixel. Draws reference their
+ * vertex stage output until Resolve, which sets up every visible triangle again and runs the
+ * pixel shader exactly once per pixel, grouped by triangle inside each screen tile.
+ * Shaders and vertex stage output of recorded draws must stay alive until Resolve.
+ */
+class VisibilityRenderer
+{
+public:
+	static constexpr int32_t TILE_SIZE = 64;
+	static constexpr int32_t TRIANGLE_ID_BITS = 22;
+	static constexpr int32_t MAX_DRAWS = (1 << (32 - TRIANGLE_ID_BITS)) - 1;
+	static constexpr int32_t MAX_TRIANGLES = 1 << TRIANGLE_ID_BITS;
+	static constexpr uint32_t INVALID_ID = 0xffffffff;
+
+	static uint32_t MakeId(int32_t draw_id, int32_t triangle_id);
+
+	VisibilityRenderer(JobSystem* job_system, FrameArena* frame_arena);
+
+	// Forgets the draws of the previous frame
+	void Reset();
+
+	// Copies the state and constants of the draw into the frame arena and keeps pointers to the vertices,
+	// triangle i uses vertices triangle_vertices[3i + 0..2], consecutive ones if nullptr
+	int32_t AddDraw(const FrameBuffer& frame_buffer, const PipelineContext& context, const math::Vector4* clip_coords, const uint8_t* varyings, const uint32_t* triangle_vertices, int32_t num_triangles);
+
+	// Shades every pixel of the visibility buffer into the frame buffer of the draw it belongs to
+	void Resolve(const FrameBuffer& frame_buffer);
+
+private:
+	struct Draw
+	{
+		FrameBuffer frame_buffer;
+		PipelineContext context;
+		const math::Vector4* clip_coords;
+		const uint8_t* varyings;
+		const uint32_t* triangle_vertices;
+	};
+
+	// Scratch of a thread, allocated from its sub-arena of the frame arena on every Resolve
+	struct ThreadData
+	{
+		PipelineContext context;
+		uint8_t* varyings;
+		uint8_t* derivatives;
+		uint8_t* clip_varyings;
+		uint64_t* pixel_keys;
+		int32_t* pixel_indices;
+	};
+
+	void ResolveTile(const FrameBuffer& frame_buffer, int32_t tile_index, int32_t thread_index);
+	void ShadeTriangle(const Draw& draw, PipelineContext& context, int32_t triangle_id, const int32_t* pixel_indices, int32_t num_pixels);
+
+private:
+	JobSystem* job_system_;
+	FrameArena* frame_arena_;
+
+	// Draws of the frame in the frame arena, Resolve copies them to one array indexed by draw id
+	FrameList<Draw, 16> draws_;
+	const Draw* resolve_draws_;
+
+	std::vector<ThreadData> thread_data_;
+};
@@ -56,6 +56,11 @@ int CALLBACK wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
 	// Initlaize application
 	application.Initialize();
 
+	if (wcsstr(lpCmdLine, L"-benchmark"))
+	{
+		application.RunRasterizerBenchmark();
+	}
+
 	HDC screen_dc = GetDC(hWnd);
 	SR_ASSERT(screen_dc);
 
@@ -103,14 +108,9 @@ int CALLBACK wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
 
 			application.Tick(delta_time);
 
-			uint8_t* pixel_buffer = graphic_device.GetPixelBuffer();
-			for (int32_t i = 0; i < num_pixels; ++i)
-			{
-				const int32_t index = i * 4;
-				ldr_buffer[index + 0] = pixel_buffer[index + 2]; // blue
-				ldr_buffer[index + 1] = pixel_buffer[index + 1]; // green
-				ldr_buffer[index + 2] = pixel_buffer[index + 0]; // red
-			}
+			// The application renders BGRA8, the same layout as the bitmap
+			SR_ASSERT(graphic_device.GetColorFormat() == COLOR_FORMAT::BGRA8_UNORM);
+			memcpy(ldr_buffer, graphic_device.ResolvePixelBuffer(), num_pixels * 4);
 
 			for (const auto& info : application.GetDebugInfos())
 			{
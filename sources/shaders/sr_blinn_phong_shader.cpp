@@ -0,0 +1,15 @@
+#include "sr_pch.h"
+#include "shaders/sr_blinn_phong_shader.h"
+
+math::Vector4 BlinnPhongShader::VertexShader(void* varyings, const void* attributes, const void* constants)
+{
+	const LitAttributeData* input = reinterpret_cast<const LitAttributeData*>(attributes);
+	const LitConstantData* uniform = reinterpret_cast<const LitConstantData*>(constants);
+	LitVertexData* out = reinterpret_cast<LitVertexData*>(varyings);
+	return lighting::TransformVertex(*out, *input, *uniform);
+}
+
+void BlinnPhongShader::LightPixels(int32_t count, const float* positions, const float* normals, const float* albedo, const void* constants, math::Vector4* colors)
+{
+	lighting::LightBatch(lighting::SPECULAR_MODEL::BLINN_PHONG, count, positions, normals, albedo, constants, colors);
+}
@@ -3,19 +3,14 @@
 
 math::Vector4 FlatShader::VertexShader(void* varyings, const void* attributes, const void* constants)
 {
-	const FlatVertexData* input = reinterpret_cast<const FlatVertexData*>(attributes);
+	const FlatAttributeData* input = reinterpret_cast<const FlatAttributeData*>(attributes);
 	const FlatConstantData* uniform = reinterpret_cast<const FlatConstantData*>(constants);
 	FlatVertexData* out = reinterpret_cast<FlatVertexData*>(varyings);
 
-	math::Vector4 out_position = input->position * uniform->world_matrix;
+	math::Vector4 out_position = math::Vector4(input->position.x, input->position.y, input->position.z, 1.0f) * uniform->world_matrix;
 	out_position = out_position * uniform->view_matrix;
 	out_position = out_position * uniform->projection_matrix;
+	out->position = out_position;
 	out->color = input->color;
 	return out->position;
 }
-
-math::Vector4 FlatShader::PixelShader(const void* varyings, const void* constants, bool& discard)
-{
-	const FlatVertexData* input = reinterpret_cast<const FlatVertexData*>(varyings);
-	return input->color;
-}
@@ -21,9 +21,28 @@ struct FlatConstantData
 	math::Matrix4x4 projection_matrix;
 };
 
-class FlatShader final : public IShader
+class FlatShader final : public ShaderBase<FlatShader>
 {
 public:
+	using Varyings = FlatVertexData;
+	static constexpr SHADER_MODE MODE = SHADER_MODE::FLAT;
+	static constexpr bool CAN_DISCARD = false;
+	static constexpr bool DEFERRED = false;
+	static constexpr VaryingLayout VARYING_LAYOUT = { 1, { { offsetof(FlatVertexData, color) / sizeof(float), 4, false } } };
+
+	static inline void ShadeBatch(const PixelBatch& pixels, const void* constants, math::Vector4* colors, uint64_t& discard_mask);
+
 	virtual math::Vector4 VertexShader(void* varyings, const void* attributes, const void* constants) override final;
-	virtual math::Vector4 PixelShader(const void* varyings, const void* constants, bool& discard) override final;
 };
+
+void FlatShader::ShadeBatch(const PixelBatch& pixels, const void* constants, math::Vector4* colors, uint64_t& discard_mask)
+{
+	const float* red = pixels.varyings + (offsetof(FlatVertexData, color) / sizeof(float)) * PIXEL_BATCH_SIZE;
+	const float* green = red + PIXEL_BATCH_SIZE;
+	const float* blue = green + PIXEL_BATCH_SIZE;
+	const float* alpha = blue + PIXEL_BATCH_SIZE;
+	for (int32_t i = 0; i < pixels.count; ++i)
+	{
+		colors[i] = math::Vector4(red[i], green[i], blue[i], alpha[i]);
+	}
+}
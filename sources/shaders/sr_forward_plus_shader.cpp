@@ -0,0 +1,17 @@
+#include "sr_pch.h"
+#include "shaders/sr_forward_plus_shader.h"
+
+math::Vector4 ForwardPlusShader::VertexShader(void* varyings, const void* attributes, const void* constants)
+{
+	const LitAttributeData* input = reinterpret_cast<const LitAttributeData*>(attributes);
+	const ForwardPlusConstantData* uniform = reinterpret_cast<const ForwardPlusConstantData*>(constants);
+	ForwardPlusVertexData* out = reinterpret_cast<ForwardPlusVertexData*>(varyings);
+
+	const math::Vector4 world_position = math::Vector4(input->position.x, input->position.y, input->position.z, 1.0f) * uniform->world_matrix;
+	const math::Vector4 world_normal = math::Vector4(input->normal.x, input->normal.y, input->normal.z, 0.0f) * uniform->world_matrix;
+	out->position = world_position * uniform->view_matrix * uniform->projection_matrix;
+	out->world_position = world_position;
+	out->normal = math::Vector4(world_normal.x, world_normal.y, world_normal.z, 0.0f);
+	out->color = input->color;
+	return out->position;
+}
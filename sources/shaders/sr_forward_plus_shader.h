@@ -0,0 +1,104 @@
+#pragma once
+
+#include "core/sr_light_culling.h"
+#include "shaders/sr_lighting.h"
+
+struct ForwardPlusVertexData
+{
+	math::Vector4 position;
+	math::Vector4 world_position;
+	math::Vector4 normal;
+	math::Vector4 color;
+};
+
+// Point lights come from the light grid of the current frame, culled per screen tile
+struct ForwardPlusConstantData
+{
+	math::Matrix4x4 world_matrix;
+	math::Matrix4x4 view_matrix;
+	math::Matrix4x4 projection_matrix;
+	math::Vector4 camera_position;
+	math::Vector4 ambient_color;
+	float specular_power;
+	float specular_intensity;
+	const LightGrid* light_grid;
+};
+
+/*
+ * Forward+ Blinn-Phong shading with many point lights
+ * Every pixel only loops over the lights of its tile in the light grid.
+ */
+class ForwardPlusShader final : public ShaderBase<ForwardPlusShader>
+{
+public:
+	using Varyings = ForwardPlusVertexData;
+	static constexpr SHADER_MODE MODE = SHADER_MODE::FORWARD_PLUS;
+	static constexpr bool CAN_DISCARD = false;
+	static constexpr bool DEFERRED = false;
+	static constexpr VaryingLayout VARYING_LAYOUT = { 3, {
+		{ offsetof(ForwardPlusVertexData, world_position) / sizeof(float), 3, false },
+		{ offsetof(ForwardPlusVertexData, normal) / sizeof(float), 3, false },
+		{ offsetof(ForwardPlusVertexData, color) / sizeof(float), 4, false } } };
+
+	static inline void ShadeBatch(const PixelBatch& pixels, const void* constants, math::Vector4* colors, uint64_t& discard_mask);
+
+	virtual math::Vector4 VertexShader(void* varyings, const void* attributes, const void* constants) override final;
+};
+
+void ForwardPlusShader::ShadeBatch(const PixelBatch& pixels, const void* constants, math::Vector4* colors, uint64_t& discard_mask)
+{
+	const ForwardPlusConstantData* uniform = reinterpret_cast<const ForwardPlusConstantData*>(constants);
+	SR_ASSERT(uniform->light_grid);
+	const LightGrid& light_grid = *uniform->light_grid;
+	const math::Vector3 camera_position(uniform->camera_position.x, uniform->camera_position.y, uniform->camera_position.z);
+	const math::Vector4& ambient = uniform->ambient_color;
+
+	// Back faces of two-sided draws are lit from the side the camera sees
+	const float facing = pixels.front_facing ? 1.0f : -1.0f;
+
+	const float* position = pixels.varyings + (offsetof(ForwardPlusVertexData, world_position) / sizeof(float)) * PIXEL_BATCH_SIZE;
+	const float* normal = pixels.varyings + (offsetof(ForwardPlusVertexData, normal) / sizeof(float)) * PIXEL_BATCH_SIZE;
+	const float* color = pixels.varyings + (offsetof(ForwardPlusVertexData, color) / sizeof(float)) * PIXEL_BATCH_SIZE;
+	for (int32_t i = 0; i < pixels.count; ++i)
+	{
+		const math::Vector3 world_position(position[i], position[PIXEL_BATCH_SIZE + i], position[PIXEL_BATCH_SIZE * 2 + i]);
+		const math::Vector3 world_normal = math::Vector3Normalize(math::Vector3(normal[i], normal[PIXEL_BATCH_SIZE + i], normal[PIXEL_BATCH_SIZE * 2 + i])) * facing;
+		const math::Vector3 view = math::Vector3Normalize(camera_position - world_position);
+		const math::Vector4 albedo(color[i], color[PIXEL_BATCH_SIZE + i], color[PIXEL_BATCH_SIZE * 2 + i], color[PIXEL_BATCH_SIZE * 3 + i]);
+
+		math::Vector3 lit(albedo.x * ambient.x, albedo.y * ambient.y, albedo.z * ambient.z);
+
+		const int32_t tile_index = (pixels.y[i] / LIGHT_TILE_SIZE) * light_grid.num_tiles_x + pixels.x[i] / LIGHT_TILE_SIZE;
+		const uint32_t end = light_grid.tile_offsets[tile_index + 1];
+		for (uint32_t j = light_grid.tile_offsets[tile_index]; j < end; ++j)
+		{
+			const PointLight& light = light_grid.lights[light_grid.light_indices[j]];
+			const math::Vector3 to_light = light.position - world_position;
+			const float distance_squared = math::Vector3LengthSquared(to_light);
+			if (distance_squared >= light.radius * light.radius)
+			{
+				continue;
+			}
+
+			const float distance = sqrtf(distance_squared);
+			const math::Vector3 light_direction = distance > 0.0f ? to_light / distance : world_normal;
+			const float diffuse = math::Vector3Dot(world_normal, light_direction);
+			if (diffuse <= 0.0f)
+			{
+				continue;
+			}
+
+			// Smooth falloff to zero at the light radius
+			const float falloff = 1.0f - distance / light.radius;
+			const float attenuation = falloff * falloff * light.intensity;
+
+			const math::Vector3 half = math::Vector3Normalize(light_direction + view);
+			const float specular = powf(math::Max(math::Vector3Dot(world_normal, half), 0.0f), uniform->specular_power) * uniform->specular_intensity;
+			lit.x += light.color.x * (albedo.x * diffuse + specular) * attenuation;
+			lit.y += light.color.y * (albedo.y * diffuse + specular) * attenuation;
+			lit.z += light.color.z * (albedo.z * diffuse + specular) * attenuation;
+		}
+
+		colors[i] = math::Vector4(lit.x, lit.y, lit.z, albedo.w);
+	}
+}
@@ -0,0 +1,20 @@
+#include "sr_pch.h"
+#include "shaders/sr_gouraud_shader.h"
+
+math::Vector4 GouraudShader::VertexShader(void* varyings, const void* attributes, const void* constants)
+{
+	const LitAttributeData* input = reinterpret_cast<const LitAttributeData*>(attributes);
+	const LitConstantData* uniform = reinterpret_cast<const LitConstantData*>(constants);
+	GouraudVertexData* out = reinterpret_cast<GouraudVertexData*>(varyings);
+
+	LitVertexData lit_vertex;
+	const math::Vector4 clip_position = lighting::TransformVertex(lit_vertex, *input, *uniform);
+	const math::Vector4 world_position = math::Vector4(input->position.x, input->position.y, input->position.z, 1.0f) * uniform->world_matrix;
+
+	const math::Vector3 normal = math::Vector3Normalize(math::Vector3(lit_vertex.normal.x, lit_vertex.normal.y, lit_vertex.normal.z));
+	const math::Vector3 view = math::Vector3Normalize(math::Vector3(uniform->camera_position.x - world_position.x, uniform->camera_position.y - world_position.y, uniform->camera_position.z - world_position.z));
+	out->position = clip_position;
+	out->color = lighting::Evaluate(lighting::SPECULAR_MODEL::PHONG, *uniform, normal, view, input->color);
+	out->back_color = lighting::Evaluate(lighting::SPECULAR_MODEL::PHONG, *uniform, -normal, view, input->color);
+	return out->position;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "shaders/sr_lighting.h"
+
+struct GouraudVertexData
+{
+	math::Vector4 position;
+	math::Vector4 color;
+	math::Vector4 back_color;
+};
+
+/*
+ * Forward Gouraud shading
+ * Lighting is evaluated per vertex and the lit color is interpolated across the triangle,
+ * the vertex stage also lights the back side so two-sided draws pick the color of the side the camera sees.
+ */
+class GouraudShader final : public ShaderBase<GouraudShader>
+{
+public:
+	using Varyings = GouraudVertexData;
+	static constexpr SHADER_MODE MODE = SHADER_MODE::GOURAUD;
+	static constexpr bool CAN_DISCARD = false;
+	static constexpr bool DEFERRED = false;
+	static constexpr VaryingLayout VARYING_LAYOUT = { 2, {
+		{ offsetof(GouraudVertexData, color) / sizeof(float), 4, false },
+		{ offsetof(GouraudVertexData, back_color) / sizeof(float), 4, false } } };
+
+	static inline void ShadeBatch(const PixelBatch& pixels, const void* constants, math::Vector4* colors, uint64_t& discard_mask);
+
+	virtual math::Vector4 VertexShader(void* varyings, const void* attributes, const void* constants) override final;
+};
+
+void GouraudShader::ShadeBatch(const PixelBatch& pixels, const void* constants, math::Vector4* colors, uint64_t& discard_mask)
+{
+	const size_t color_offset = pixels.front_facing ? offsetof(GouraudVertexData, color) : offsetof(GouraudVertexData, back_color);
+	const float* red = pixels.varyings + (color_offset / sizeof(float)) * PIXEL_BATCH_SIZE;
+	const float* green = red + PIXEL_BATCH_SIZE;
+	const float* blue = green + PIXEL_BATCH_SIZE;
+	const float* alpha = blue + PIXEL_BATCH_SIZE;
+	for (int32_t i = 0; i < pixels.count; ++i)
+	{
+		colors[i] = math::Vector4(red[i], green[i], blue[i], alpha[i]);
+	}
+}
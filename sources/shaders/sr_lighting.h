@@ -0,0 +1,141 @@
+#pragma once
+
+#include "shaders/sr_shader_interface.h"
+
+struct LitAttributeData
+{
+	math::Vector3 position;
+	math::Vector3 normal;
+	math::Vector4 color;
+};
+
+// Varyings of the shaders that light per pixel, the normal is in world space with w = 0
+struct LitVertexData
+{
+	math::Vector4 position;
+	math::Vector4 normal;
+	math::Vector4 color;
+};
+
+// One directional light, light_direction points from the light into the scene
+// inverse_view_projection is the inverse of view_matrix * projection_matrix, set together with them
+// so the lighting pass takes G-buffer positions back to world space without inverting per batch
+struct LitConstantData
+{
+	math::Matrix4x4 world_matrix;
+	math::Matrix4x4 view_matrix;
+	math::Matrix4x4 projection_matrix;
+	math::Matrix4x4 inverse_view_projection;
+	math::Vector4 camera_position;
+	math::Vector4 light_direction;
+	math::Vector4 light_color;
+	math::Vector4 ambient_color;
+	float specular_power;
+	float specular_intensity;
+};
+
+namespace lighting
+{
+	enum class SPECULAR_MODEL : uint8_t
+	{
+		PHONG,
+		BLINN_PHONG,
+	};
+
+	// Normal and color of LitVertexData, written to the G-buffer by the geometry pass
+	constexpr VaryingLayout GBUFFER_VARYING_LAYOUT = { 2, {
+		{ offsetof(LitVertexData, normal) / sizeof(float), 3, false },
+		{ offsetof(LitVertexData, color) / sizeof(float), 4, false } } };
+
+	/* Ambient, diffuse and specular terms of the light, normal and view direction are unit vectors */
+	inline math::Vector4 Evaluate(SPECULAR_MODEL model, const LitConstantData& constants, const math::Vector3& normal, const math::Vector3& view, const math::Vector4& albedo);
+
+	/* World position, world normal and clip position of a lit vertex */
+	inline math::Vector4 TransformVertex(LitVertexData& out, const LitAttributeData& input, const LitConstantData& constants);
+
+	/* Geometry pass, albedo to colors[j] and the normalized normal to colors[PIXEL_BATCH_SIZE + j], negated on back faces */
+	inline void ShadeGBuffer(int32_t count, const float* varyings, bool front_facing, math::Vector4* colors);
+
+	/* Lighting pass, positions in normalized device coordinates are taken back to world space */
+	inline void LightBatch(SPECULAR_MODEL model, int32_t count, const float* positions, const float* normals, const float* albedo, const void* constants, math::Vector4* colors);
+}
+
+math::Vector4 lighting::Evaluate(SPECULAR_MODEL model, const LitConstantData& constants, const math::Vector3& normal, const math::Vector3& view, const math::Vector4& albedo)
+{
+	const math::Vector3 light = math::Vector3Normalize(-math::Vector3(constants.light_direction.x, constants.light_direction.y, constants.light_direction.z));
+	const float diffuse = math::Max(math::Vector3Dot(normal, light), 0.0f);
+
+	float specular = 0.0f;
+	if (diffuse > 0.0f)
+	{
+		if (model == SPECULAR_MODEL::PHONG)
+		{
+			// Reflected light direction against the view direction
+			const math::Vector3 reflected = normal * (2.0f * math::Vector3Dot(normal, light)) - light;
+			specular = powf(math::Max(math::Vector3Dot(reflected, view), 0.0f), constants.specular_power);
+		}
+		else
+		{
+			// Half vector against the normal
+			const math::Vector3 half = math::Vector3Normalize(light + view);
+			specular = powf(math::Max(math::Vector3Dot(normal, half), 0.0f), constants.specular_power);
+		}
+	}
+
+	const math::Vector4& light_color = constants.light_color;
+	const math::Vector4& ambient = constants.ambient_color;
+	const float specular_scale = specular * constants.specular_intensity;
+	return math::Vector4(
+		albedo.x * (ambient.x + light_color.x * diffuse) + light_color.x * specular_scale,
+		albedo.y * (ambient.y + light_color.y * diffuse) + light_color.y * specular_scale,
+		albedo.z * (ambient.z + light_color.z * diffuse) + light_color.z * specular_scale,
+		albedo.w);
+}
+
+math::Vector4 lighting::TransformVertex(LitVertexData& out, const LitAttributeData& input, const LitConstantData& constants)
+{
+	const math::Vector4 world_position = math::Vector4(input.position.x, input.position.y, input.position.z, 1.0f) * constants.world_matrix;
+	const math::Vector4 world_normal = math::Vector4(input.normal.x, input.normal.y, input.normal.z, 0.0f) * constants.world_matrix;
+	out.position = world_position * constants.view_matrix * constants.projection_matrix;
+	out.normal = math::Vector4(world_normal.x, world_normal.y, world_normal.z, 0.0f);
+	out.color = input.color;
+	return out.position;
+}
+
+void lighting::ShadeGBuffer(int32_t count, const float* varyings, bool front_facing, math::Vector4* colors)
+{
+	// Back faces of two-sided draws are lit from the side the camera sees
+	const float facing = front_facing ? 1.0f : -1.0f;
+	const float* normal_x = varyings + (offsetof(LitVertexData, normal) / sizeof(float)) * PIXEL_BATCH_SIZE;
+	const float* normal_y = normal_x + PIXEL_BATCH_SIZE;
+	const float* normal_z = normal_y + PIXEL_BATCH_SIZE;
+	const float* red = varyings + (offsetof(LitVertexData, color) / sizeof(float)) * PIXEL_BATCH_SIZE;
+	const float* green = red + PIXEL_BATCH_SIZE;
+	const float* blue = green + PIXEL_BATCH_SIZE;
+	const float* alpha = blue + PIXEL_BATCH_SIZE;
+	for (int32_t i = 0; i < count; ++i)
+	{
+		// Interpolated normals are no longer unit length
+		const math::Vector3 normal = math::Vector3Normalize(math::Vector3(normal_x[i], normal_y[i], normal_z[i])) * facing;
+		colors[i] = math::Vector4(red[i], green[i], blue[i], alpha[i]);
+		colors[PIXEL_BATCH_SIZE + i] = math::Vector4(normal.x, normal.y, normal.z, 0.0f);
+	}
+}
+
+void lighting::LightBatch(SPECULAR_MODEL model, int32_t count, const float* positions, const float* normals, const float* albedo, const void* constants, math::Vector4* colors)
+{
+	const LitConstantData* uniform = reinterpret_cast<const LitConstantData*>(constants);
+	const math::Vector3 camera_position(uniform->camera_position.x, uniform->camera_position.y, uniform->camera_position.z);
+
+	for (int32_t i = 0; i < count; ++i)
+	{
+		const math::Vector4 ndc(positions[i], positions[PIXEL_BATCH_SIZE + i], positions[PIXEL_BATCH_SIZE * 2 + i], 1.0f);
+		const math::Vector4 world = ndc * uniform->inverse_view_projection;
+		const math::Vector3 position = math::Vector3(world.x, world.y, world.z) / world.w;
+
+		const math::Vector3 normal(normals[i], normals[PIXEL_BATCH_SIZE + i], normals[PIXEL_BATCH_SIZE * 2 + i]);
+		const math::Vector3 view = math::Vector3Normalize(camera_position - position);
+		const math::Vector4 color(albedo[i], albedo[PIXEL_BATCH_SIZE + i], albedo[PIXEL_BATCH_SIZE * 2 + i], albedo[PIXEL_BATCH_SIZE * 3 + i]);
+		colors[i] = Evaluate(model, *uniform, normal, view, color);
+	}
+}
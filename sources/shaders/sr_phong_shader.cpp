@@ -0,0 +1,15 @@
+#include "sr_pch.h"
+#include "shaders/sr_phong_shader.h"
+
+math::Vector4 PhongShader::VertexShader(void* varyings, const void* attributes, const void* constants)
+{
+	const LitAttributeData* input = reinterpret_cast<const LitAttributeData*>(attributes);
+	const LitConstantData* uniform = reinterpret_cast<const LitConstantData*>(constants);
+	LitVertexData* out = reinterpret_cast<LitVertexData*>(varyings);
+	return lighting::TransformVertex(*out, *input, *uniform);
+}
+
+void PhongShader::LightPixels(int32_t count, const float* positions, const float* normals, const float* albedo, const void* constants, math::Vector4* colors)
+{
+	lighting::LightBatch(lighting::SPECULAR_MODEL::PHONG, count, positions, normals, albedo, constants, colors);
+}
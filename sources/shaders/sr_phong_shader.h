@@ -0,0 +1,28 @@
+#pragma once
+
+#include "shaders/sr_lighting.h"
+
+/*
+ * Deferred Phong shading
+ * The geometry pass writes albedo and normal to the G-buffer, LightPixels evaluates the
+ * reflection-vector specular term once per visible pixel.
+ */
+class PhongShader final : public ShaderBase<PhongShader>
+{
+public:
+	using Varyings = LitVertexData;
+	static constexpr SHADER_MODE MODE = SHADER_MODE::PHONG;
+	static constexpr bool CAN_DISCARD = false;
+	static constexpr bool DEFERRED = true;
+	static constexpr VaryingLayout VARYING_LAYOUT = lighting::GBUFFER_VARYING_LAYOUT;
+
+	static inline void ShadeBatch(const PixelBatch& pixels, const void* constants, math::Vector4* colors, uint64_t& discard_mask);
+
+	virtual math::Vector4 VertexShader(void* varyings, const void* attributes, const void* constants) override final;
+	virtual void LightPixels(int32_t count, const float* positions, const float* normals, const float* albedo, const void* constants, math::Vector4* colors) override final;
+};
+
+void PhongShader::ShadeBatch(const PixelBatch& pixels, const void* constants, math::Vector4* colors, uint64_t& discard_mask)
+{
+	lighting::ShadeGBuffer(pixels.count, pixels.varyings, pixels.front_facing, colors);
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "core/sr_core_types.h"
 #include "core/sr_math.h"
 
 enum class SHADER_MODE : uint8_t
@@ -8,11 +9,90 @@ enum class SHADER_MODE : uint8_t
 	GOURAUD,
 	PHONG,
 	BLINN_PHONG,
+	FORWARD_PLUS,
+	TEXTURED,
+};
+
+// Pixels per ShadePixels call, batch varyings are stored per component with this stride
+constexpr int32_t PIXEL_BATCH_SIZE = 64;
+
+// Pixels of one ShadePixels call, component i of pixel j is varyings[i * PIXEL_BATCH_SIZE + j]
+// varyings_ddx and varyings_ddy use the same layout, filled for attributes that declare derivatives
+// Components outside the varying layout, and derivatives that are not declared, read as zero
+struct PixelBatch
+{
+	int32_t count;
+	const int32_t* x;
+	const int32_t* y;
+	const float* varyings;
+	const float* varyings_ddx;
+	const float* varyings_ddy;
+	bool front_facing;
 };
 
 class IShader
 {
 public:
+	virtual ~IShader() = default;
+
 	virtual math::Vector4 VertexShader(void* varyings, const void* attributes, const void* constants) = 0;
-	virtual math::Vector4 PixelShader(const void* varyings, const void* constants, bool& discard) = 0;
+
+	// Batched pixel stage, discarded pixels set their bit in discard_mask
+	// Deferred shaders write albedo to colors[j] and the world-space normal to colors[PIXEL_BATCH_SIZE + j]
+	virtual void ShadePixels(const PixelBatch& pixels, const void* constants, math::Vector4* colors, uint64_t& discard_mask) = 0;
+
+	// Lighting pass of deferred shaders, runs once per pixel the geometry pass covered
+	// positions hold x, y, z in normalized device coordinates, normals x, y, z and albedo r, g, b, a, each component with PIXEL_BATCH_SIZE stride
+	// Only deferred shaders override it, the G-buffer is never lit with a forward shader
+	virtual void LightPixels(int32_t count, const float* positions, const float* normals, const float* albedo, const void* constants, math::Vector4* colors)
+	{
+		SR_ASSERT(false);
+	}
+
+	// Shaders that never discard let the rasterizer write depth before the pixel shader runs
+	virtual bool CanDiscard() const = 0;
+
+	// Deferred shaders render into the G-buffer and are lit by LightPixels afterwards
+	virtual bool IsDeferred() const = 0;
+
+	// Components the pixel stage reads, everything else in the varyings is not interpolated
+	virtual const VaryingLayout& GetVaryingLayout() const = 0;
+
+	// Identifies the shader class to the registry of specialized rasterizer kernels
+	virtual SHADER_MODE GetMode() const = 0;
+};
+
+/*
+ * Implements the IShader queries and the batched pixel stage from the compile-time description of Derived
+ * Derived declares Varyings, MODE, CAN_DISCARD, DEFERRED, VARYING_LAYOUT and a static ShadeBatch,
+ * the specialized rasterizer kernels call ShadeBatch directly and the dynamic pipeline goes through ShadePixels.
+ */
+template <typename Derived>
+class ShaderBase : public IShader
+{
+public:
+	virtual void ShadePixels(const PixelBatch& pixels, const void* constants, math::Vector4* colors, uint64_t& discard_mask) override final
+	{
+		Derived::ShadeBatch(pixels, constants, colors, discard_mask);
+	}
+
+	virtual bool CanDiscard() const override final
+	{
+		return Derived::CAN_DISCARD;
+	}
+
+	virtual bool IsDeferred() const override final
+	{
+		return Derived::DEFERRED;
+	}
+
+	virtual const VaryingLayout& GetVaryingLayout() const override final
+	{
+		return Derived::VARYING_LAYOUT;
+	}
+
+	virtual SHADER_MODE GetMode() const override final
+	{
+		return Derived::MODE;
+	}
 };
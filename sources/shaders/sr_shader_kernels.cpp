@@ -0,0 +1,84 @@
+#include "sr_pch.h"
+#include "core/sr_rasterizer_kernels.h"
+#include "shaders/sr_blinn_phong_shader.h"
+#include "shaders/sr_flat_shader.h"
+#include "shaders/sr_forward_plus_shader.h"
+#include "shaders/sr_gouraud_shader.h"
+#include "shaders/sr_phong_shader.h"
+#include "shaders/sr_textured_shader.h"
+
+struct SpecializedKernel
+{
+	rasterizer::RasterizeFunction rasterize_function;
+	SHADER_MODE shader_mode;
+	int32_t sizeof_varyings;
+	bool enable_blend;
+	DEPTH_FUNC depth_func;
+	bool depth_write;
+	rasterizer::RasterizeFunction kernel;
+};
+
+template<typename Shader, bool BLEND, DEPTH_FUNC FUNC, bool DEPTH_WRITE>
+static void RegisterKernels(std::vector<SpecializedKernel>& kernels)
+{
+	using Pipeline = SpecializedPipeline<Shader, BLEND, FUNC, DEPTH_WRITE>;
+	const int32_t sizeof_varyings = sizeof(typename Shader::Varyings);
+	kernels.push_back({ rasterizer::RasterizeTriangle_V1, Shader::MODE, sizeof_varyings, BLEND, FUNC, DEPTH_WRITE, RasterizeKernel_V1<Pipeline> });
+	kernels.push_back({ rasterizer::RasterizeTriangle_V2, Shader::MODE, sizeof_varyings, BLEND, FUNC, DEPTH_WRITE, RasterizeKernel_V2<Pipeline> });
+	kernels.push_back({ rasterizer::RasterizeTriangle_V3, Shader::MODE, sizeof_varyings, BLEND, FUNC, DEPTH_WRITE, RasterizeKernel_V3<Pipeline> });
+}
+
+template<typename Shader>
+static void RegisterShaderKernels(std::vector<SpecializedKernel>& kernels)
+{
+	// Depth disabled, the common depth states, with and without blending
+	RegisterKernels<Shader, false, DEPTH_FUNC::ALWAYS, false>(kernels);
+	RegisterKernels<Shader, false, DEPTH_FUNC::LESS, true>(kernels);
+	RegisterKernels<Shader, false, DEPTH_FUNC::LESS_EQUAL, true>(kernels);
+	RegisterKernels<Shader, false, DEPTH_FUNC::LESS_EQUAL, false>(kernels);
+	RegisterKernels<Shader, true, DEPTH_FUNC::ALWAYS, false>(kernels);
+	RegisterKernels<Shader, true, DEPTH_FUNC::LESS, true>(kernels);
+	RegisterKernels<Shader, true, DEPTH_FUNC::LESS_EQUAL, true>(kernels);
+	RegisterKernels<Shader, true, DEPTH_FUNC::LESS_EQUAL, false>(kernels);
+}
+
+static const std::vector<SpecializedKernel>& GetSpecializedKernels()
+{
+	static const std::vector<SpecializedKernel> kernels = []()
+	{
+		std::vector<SpecializedKernel> result;
+		RegisterShaderKernels<FlatShader>(result);
+		RegisterShaderKernels<GouraudShader>(result);
+		RegisterShaderKernels<PhongShader>(result);
+		RegisterShaderKernels<BlinnPhongShader>(result);
+		RegisterShaderKernels<ForwardPlusShader>(result);
+		RegisterShaderKernels<TexturedShader>(result);
+		return result;
+	}();
+	return kernels;
+}
+
+rasterizer::RasterizeFunction rasterizer::SelectRasterizeFunction(RasterizeFunction rasterize_function, const PipelineContext& context)
+{
+	SR_ASSERT(rasterize_function);
+	SR_ASSERT(context.shader);
+
+	// Disabled depth testing matches the kernels built for DEPTH_FUNC::ALWAYS without writes
+	const SHADER_MODE shader_mode = context.shader->GetMode();
+	const DEPTH_FUNC depth_func = context.depth_test ? context.depth_func : DEPTH_FUNC::ALWAYS;
+	const bool depth_write = context.depth_test && context.depth_write;
+	for (const SpecializedKernel& kernel : GetSpecializedKernels())
+	{
+		if (kernel.rasterize_function == rasterize_function &&
+			kernel.shader_mode == shader_mode &&
+			kernel.sizeof_varyings == context.sizeof_varyings &&
+			kernel.enable_blend == context.enable_blend &&
+			kernel.depth_func == depth_func &&
+			kernel.depth_write == depth_write)
+		{
+			return kernel.kernel;
+		}
+	}
+
+	return rasterize_function;
+}
@@ -0,0 +1,16 @@
+#include "sr_pch.h"
+#include "shaders/sr_textured_shader.h"
+
+math::Vector4 TexturedShader::VertexShader(void* varyings, const void* attributes, const void* constants)
+{
+	const TexturedAttributeData* input = reinterpret_cast<const TexturedAttributeData*>(attributes);
+	const TexturedConstantData* uniform = reinterpret_cast<const TexturedConstantData*>(constants);
+	TexturedVertexData* out = reinterpret_cast<TexturedVertexData*>(varyings);
+
+	math::Vector4 out_position = math::Vector4(input->position.x, input->position.y, input->position.z, 1.0f) * uniform->world_matrix;
+	out_position = out_position * uniform->view_matrix;
+	out_position = out_position * uniform->projection_matrix;
+	out->position = out_position;
+	out->uv = input->uv;
+	return out->position;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "shaders/sr_shader_interface.h"
+#include "core/sr_texture.h"
+
+struct TexturedAttributeData
+{
+	math::Vector3 position;
+	math::Vector2 uv;
+};
+
+struct TexturedVertexData
+{
+	math::Vector4 position;
+	math::Vector2 uv;
+};
+
+struct TexturedConstantData
+{
+	math::Matrix4x4 world_matrix;
+	math::Matrix4x4 view_matrix;
+	math::Matrix4x4 projection_matrix;
+	const Texture2D* texture;
+	SamplerState sampler;
+};
+
+/*
+ * Unlit texture mapping
+ * The pixel stage samples the texture at the interpolated texture coordinates of the whole batch in one call,
+ * the texture coordinates declare derivatives so every pixel samples with the gradients of its 2x2 quad.
+ */
+class TexturedShader final : public ShaderBase<TexturedShader>
+{
+public:
+	using Varyings = TexturedVertexData;
+	static constexpr SHADER_MODE MODE = SHADER_MODE::TEXTURED;
+	static constexpr bool CAN_DISCARD = false;
+	static constexpr bool DEFERRED = false;
+	static constexpr VaryingLayout VARYING_LAYOUT = { 1, { { offsetof(TexturedVertexData, uv) / sizeof(float), 2, true } } };
+
+	static inline void ShadeBatch(const PixelBatch& pixels, const void* constants, math::Vector4* colors, uint64_t& discard_mask);
+
+	virtual math::Vector4 VertexShader(void* varyings, const void* attributes, const void* constants) override final;
+};
+
+void TexturedShader::ShadeBatch(const PixelBatch& pixels, const void* constants, math::Vector4* colors, uint64_t& discard_mask)
+{
+	const TexturedConstantData* uniform = reinterpret_cast<const TexturedConstantData*>(constants);
+	SR_ASSERT(uniform->texture);
+
+	const int32_t u_offset = (offsetof(TexturedVertexData, uv) / sizeof(float)) * PIXEL_BATCH_SIZE;
+	const int32_t v_offset = u_offset + PIXEL_BATCH_SIZE;
+	texture::SampleBatch(*uniform->texture, uniform->sampler, pixels.count,
+		pixels.varyings + u_offset, pixels.varyings + v_offset,
+		pixels.varyings_ddx + u_offset, pixels.varyings_ddx + v_offset,
+		pixels.varyings_ddy + u_offset, pixels.varyings_ddy + v_offset,
+		colors);
+}
@@ -2,8 +2,19 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <immintrin.h>
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
 #include <format>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <type_traits>
 #include <vector>
 #include "stb/stb_image.h"
 